@@ -0,0 +1,373 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "sort.hpp"
+
+namespace tinystl {
+
+// out-of-core sort: the input is cut into chunks that fit the memory budget, every chunk is sorted
+// with intro_sort and spilled to a temporary run file, and the runs are k-way merged through a loser tree
+struct external_sort_options {
+    std::size_t memory_budget = std::size_t(1) << 30;   // bytes for the chunk being sorted, and for all merge buffers together
+    std::size_t io_block = std::size_t(4) << 20;        // bytes per sequential read or write
+    std::filesystem::path temp_dir = std::filesystem::temp_directory_path();
+};
+
+// serialization hooks move blocks of elements between a FILE* and memory: read returns how many elements it
+// got (fewer only at the end of the file), write throws on failure, footprint is the in-memory size of a value
+template <typename T>
+struct raw_serializer {
+    static_assert(std::is_trivially_copyable<T>::value, "raw_serializer needs a trivially copyable type");
+
+    std::size_t read(std::FILE* in, T* out, std::size_t count) const {
+        return std::fread(out, sizeof(T), count, in);
+    }
+
+    void write(std::FILE* out, const T* in, std::size_t count) const {
+        if (std::fwrite(in, sizeof(T), count, out) != count) {
+            throw std::runtime_error("external_sort: write failed");
+        }
+    }
+
+    std::size_t footprint(const T&) const { return sizeof(T); }
+};
+
+namespace detail {
+
+struct file_closer {
+    void operator()(std::FILE* file) const { std::fclose(file); }
+};
+
+using file_ptr = std::unique_ptr<std::FILE, file_closer>;
+
+inline file_ptr open_file(const std::filesystem::path& path, const char* mode, std::size_t io_block) {
+    file_ptr file(std::fopen(path.c_str(), mode));
+    if (!file) {
+        throw std::runtime_error("external_sort: cannot open " + path.string());
+    }
+    // the stdio buffer is bypassed by block-sized fread/fwrite calls, keep it small for the odd short access
+    std::setvbuf(file.get(), nullptr, _IOFBF, std::min<std::size_t>(io_block, 1 << 16));
+    return file;
+}
+
+// run files live in the temp dir for the lifetime of one sort and are removed even when it throws
+class temp_files {
+public:
+    explicit temp_files(std::filesystem::path dir) : dir_(std::move(dir)), prefix_(std::to_string(std::random_device{}())) {}
+
+    temp_files(const temp_files&) = delete;
+    temp_files& operator=(const temp_files&) = delete;
+
+    ~temp_files() {
+        std::error_code error;
+        for (auto& path : paths_) {
+            std::filesystem::remove(path, error);
+        }
+    }
+
+    const std::filesystem::path& create() {
+        paths_.push_back(dir_ / ("tinystl_run_" + prefix_ + "_" + std::to_string(paths_.size())));
+        return paths_.back();
+    }
+
+    void remove(const std::filesystem::path& path) {
+        std::error_code error;
+        std::filesystem::remove(path, error);
+    }
+
+private:
+    std::filesystem::path dir_;
+    std::string prefix_;
+    std::vector<std::filesystem::path> paths_;
+};
+
+// sequential reader over one sorted run, refilled a block at a time
+template <typename T, typename Serializer>
+class run_reader {
+public:
+    run_reader(const std::filesystem::path& path, std::size_t block, std::size_t io_block, Serializer& serializer)
+        : file_(open_file(path, "rb", io_block)), block_(block), serializer_(serializer) {
+        refill();
+    }
+
+    bool exhausted() const { return pos_ == count_; }
+    const T& head() const { return block_[pos_]; }
+    T& head() { return block_[pos_]; }
+
+    void advance() {
+        if (++pos_ == count_ && count_ == block_.size()) {
+            refill();
+        }
+    }
+
+private:
+    void refill() {
+        count_ = serializer_.read(file_.get(), block_.data(), block_.size());
+        pos_ = 0;
+    }
+
+    file_ptr file_;
+    std::vector<T> block_;
+    std::size_t pos_ = 0;
+    std::size_t count_ = 0;
+    Serializer& serializer_;
+};
+
+template <typename T, typename Serializer>
+class run_writer {
+public:
+    run_writer(const std::filesystem::path& path, std::size_t block, std::size_t io_block, Serializer& serializer)
+        : file_(open_file(path, "wb", io_block)), serializer_(serializer) {
+        block_.reserve(block);
+    }
+
+    void push(T&& value) {
+        block_.push_back(std::move(value));
+        if (block_.size() == block_.capacity()) {
+            flush();
+        }
+    }
+
+    void write(const T* first, std::size_t count) {
+        flush();
+        serializer_.write(file_.get(), first, count);
+    }
+
+    void close() {
+        flush();
+        if (std::fflush(file_.get()) != 0) {
+            throw std::runtime_error("external_sort: write failed");
+        }
+        file_.reset();
+    }
+
+private:
+    void flush() {
+        if (!block_.empty()) {
+            serializer_.write(file_.get(), block_.data(), block_.size());
+            block_.clear();
+        }
+    }
+
+    file_ptr file_;
+    std::vector<T> block_;
+    Serializer& serializer_;
+};
+
+// tournament tree of losers over k runs: tree_[0] is the current winner and replacing it replays only the
+// log2(k) matches on its path against the loser stored at each node
+template <typename T, typename Serializer, typename Compare>
+class loser_tree {
+public:
+    loser_tree(std::vector<run_reader<T, Serializer>>& runs, Compare& compare)
+        : runs_(runs), compare_(compare), tree_(runs.size()) {
+        tree_[0] = build(1);
+    }
+
+    bool empty() const { return runs_[tree_[0]].exhausted(); }
+    T& top() { return runs_[tree_[0]].head(); }
+
+    void pop() {
+        std::size_t winner = tree_[0];
+        runs_[winner].advance();
+        for (std::size_t node = (winner + runs_.size()) / 2; node > 0; node /= 2) {
+            if (beats(tree_[node], winner)) {
+                std::swap(tree_[node], winner);
+            }
+        }
+        tree_[0] = winner;
+    }
+
+private:
+    // exhausted runs lose every match and ties go to the earlier run, written so that either comparator flavour works
+    bool beats(std::size_t a, std::size_t b) {
+        if (runs_[a].exhausted() || runs_[b].exhausted()) {
+            return !runs_[a].exhausted();
+        }
+        return a < b ? compare_(runs_[a].head(), runs_[b].head()) || !compare_(runs_[b].head(), runs_[a].head())
+                     : compare_(runs_[a].head(), runs_[b].head()) && !compare_(runs_[b].head(), runs_[a].head());
+    }
+
+    std::size_t build(std::size_t node) {
+        if (node >= runs_.size()) {
+            return node - runs_.size();
+        }
+        std::size_t a = build(node * 2);
+        std::size_t b = build(node * 2 + 1);
+        if (beats(a, b)) {
+            tree_[node] = b;
+            return a;
+        }
+        tree_[node] = a;
+        return b;
+    }
+
+    std::vector<run_reader<T, Serializer>>& runs_;
+    Compare& compare_;
+    std::vector<std::size_t> tree_;
+};
+
+template <typename T, typename Compare, typename Serializer>
+void merge_runs(const std::vector<std::filesystem::path>& inputs, const std::filesystem::path& output,
+                Compare& compare, const external_sort_options& options, Serializer& serializer) {
+    // the budget is shared by one block per input run plus the output block
+    std::size_t block = std::max<std::size_t>(1, std::min(options.io_block, options.memory_budget / (inputs.size() + 1)) / sizeof(T));
+    std::vector<run_reader<T, Serializer>> runs;
+    runs.reserve(inputs.size());
+    for (auto& input : inputs) {
+        runs.emplace_back(input, block, options.io_block, serializer);
+    }
+    run_writer<T, Serializer> writer(output, block, options.io_block, serializer);
+    loser_tree<T, Serializer, Compare> tree(runs, compare);
+    for (; !tree.empty(); tree.pop()) {
+        writer.push(std::move(tree.top()));
+    }
+    writer.close();
+}
+
+// stage 1 and 2: read chunks through next_block until the budget is used up, sort them and spill them as runs
+template <typename T, typename NextBlock, typename Compare, typename Serializer>
+void external_sort_impl(NextBlock&& next_block, const std::filesystem::path& output, Compare& compare,
+                        const external_sort_options& requested, Serializer& serializer) {
+    // a merge needs room for two input blocks and the output block, so an io block never takes more than a
+    // third of the budget
+    external_sort_options options = requested;
+    options.io_block = std::max(sizeof(T), std::min(options.io_block, options.memory_budget / 3));
+    temp_files temps(options.temp_dir);
+    std::vector<std::filesystem::path> runs;
+    std::size_t block = std::max<std::size_t>(1, options.io_block / sizeof(T));
+    // reserved once so growing the chunk never doubles past the budget
+    std::vector<T> chunk;
+    chunk.reserve(std::max<std::size_t>(1, options.memory_budget / sizeof(T)));
+    bool done = false;
+    while (!done) {
+        chunk.clear();
+        std::size_t bytes = 0;
+        while (bytes < options.memory_budget) {
+            // the last read of a chunk asks only for what is left of the budget
+            std::size_t wanted = std::min(block, std::max<std::size_t>(1, (options.memory_budget - bytes) / sizeof(T)));
+            std::size_t old_size = chunk.size();
+            chunk.resize(old_size + wanted);
+            std::size_t count = next_block(chunk.data() + old_size, wanted);
+            chunk.resize(old_size + count);
+            for (std::size_t i = old_size; i < chunk.size(); ++i) {
+                bytes += serializer.footprint(chunk[i]);
+            }
+            if (count < wanted) {
+                done = true;
+                break;
+            }
+        }
+        if (chunk.empty() && !runs.empty()) {
+            break;
+        }
+        intro_sort(chunk.begin(), chunk.end(), compare);
+        // a single chunk is the whole input, write it straight to the output
+        const auto& path = done && runs.empty() ? output : temps.create();
+        run_writer<T, Serializer> writer(path, block, options.io_block, serializer);
+        writer.write(chunk.data(), chunk.size());
+        writer.close();
+        if (done && runs.empty()) {
+            return;
+        }
+        runs.push_back(path);
+    }
+    chunk = std::vector<T>();
+
+    // stage 3: merge as many runs per pass as the budget has io blocks for, the last pass writes the output
+    std::size_t blocks = options.memory_budget / options.io_block;
+    std::size_t fan_in = blocks > 3 ? blocks - 1 : 2;
+    while (runs.size() > fan_in) {
+        std::vector<std::filesystem::path> merged;
+        for (std::size_t i = 0; i < runs.size(); i += fan_in) {
+            std::vector<std::filesystem::path> group(runs.begin() + i, runs.begin() + std::min(i + fan_in, runs.size()));
+            if (group.size() == 1) {
+                merged.push_back(group.front());
+                continue;
+            }
+            merged.push_back(temps.create());
+            merge_runs<T>(group, merged.back(), compare, options, serializer);
+            for (auto& path : group) {
+                temps.remove(path);
+            }
+        }
+        runs.swap(merged);
+    }
+    merge_runs<T>(runs, output, compare, options, serializer);
+}
+
+}
+
+// sorts the elements stored in input_path into output_path
+template <typename T, typename Compare = std::less_equal<T>, typename Serializer = raw_serializer<T>>
+void external_sort(const std::filesystem::path& input_path, const std::filesystem::path& output_path,
+                   Compare compare = Compare{}, const external_sort_options& options = external_sort_options{},
+                   Serializer serializer = Serializer{}) {
+    auto input = detail::open_file(input_path, "rb", options.io_block);
+    detail::external_sort_impl<T>([&](T* out, std::size_t count) { return serializer.read(input.get(), out, count); },
+                                  output_path, compare, options, serializer);
+}
+
+// sorts an in-memory or memory-mapped range into output_path, the range itself is only read
+template <typename T, typename Compare = std::less_equal<T>, typename Serializer = raw_serializer<T>>
+void external_sort(const T* first, const T* last, const std::filesystem::path& output_path,
+                   Compare compare = Compare{}, const external_sort_options& options = external_sort_options{},
+                   Serializer serializer = Serializer{}) {
+    detail::external_sort_impl<T>([&](T* out, std::size_t count) {
+        count = std::min<std::size_t>(count, last - first);
+        std::copy(first, first + count, out);
+        first += count;
+        return count;
+    }, output_path, compare, options, serializer);
+}
+
+#if __has_include(<sys/mman.h>)
+
+// maps a file of raw elements and streams it through the range overload, the kernel reads ahead sequentially
+// and drops the pages again under memory pressure, so the mapping does not count against the budget
+template <typename T, typename Compare = std::less_equal<T>>
+void external_sort_mapped(const std::filesystem::path& input_path, const std::filesystem::path& output_path,
+                          Compare compare = Compare{}, const external_sort_options& options = external_sort_options{}) {
+    static_assert(std::is_trivially_copyable<T>::value, "a mapped file can only hold trivially copyable elements");
+    int fd = ::open(input_path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("external_sort: cannot open " + input_path.string());
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+        ::close(fd);
+        throw std::runtime_error("external_sort: cannot stat " + input_path.string());
+    }
+    std::size_t size = static_cast<std::size_t>(info.st_size) / sizeof(T) * sizeof(T);
+    void* data = size == 0 ? nullptr : ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        throw std::runtime_error("external_sort: cannot map " + input_path.string());
+    }
+    std::unique_ptr<void, std::function<void(void*)>> mapping(data, [size](void* p) { if (p) ::munmap(p, size); });
+    if (data != nullptr) {
+        ::madvise(data, size, MADV_SEQUENTIAL);
+    }
+    const T* first = static_cast<const T*>(data);
+    external_sort(first, first + size / sizeof(T), output_path, compare, options);
+}
+
+#endif
+
+}
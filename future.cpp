@@ -1,126 +1,26 @@
-#include <memory>
+#include <chrono>
+#include <exception>
+#include <fstream>
 #include <iostream>
-#include <functional>
-#include <vector>
 #include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
 
-template <typename T>
-class Try {
-public:
-    Try() {}
-    explicit Try(T&& t) : result_(std::forward<T>(t)) {}
-
-    Try(Try&& t) noexcept : result_(std::move(t.result_)) {}
-
-    Try& operator=(Try&& t) noexcept { result_ = std::move(t.result_); return *this; }
-
-    T&& result() noexcept  { return std::move(result_); }
-private:
-    T result_;
-};
-
-template <typename T>
-Try<T> make_try(T&& t) {
-    return Try<T>(std::forward<T>(t));
-}
-
-template <typename T>
-class Core {
-public:
-    using Result = Try<T>;
-    using Callback = std::function<void(Result&&)>;
-
-    enum class State {
-        START,
-        READY,
-        RESULT,
-        CALLBACK,
-        DONE
-    };
-
-    Core() : state_(State::START), callback_(nullptr) {}
-
-    explicit Core(Try<T>&& t) : state_(State::RESULT), result_(std::forward<Try<T>>(t)), callback_(nullptr) {}
-
-    Core(Core&& core) noexcept : state_(core.state_), result_(std::move(core.result_)), callback_(std::move(core.callback_)) {}
-
-    Result&& result() noexcept { return std::move(result_); }
-
-    void set_callback(Callback callback) noexcept {
-        callback_ = std::move(callback);
-
-        if (state_ == State::RESULT || state_ == State::CALLBACK) {
-            state_ = State::DONE;
-            callback_(std::move(result_));
-        }
-    }
-
-    void set_try(Try<T>&& t) {
-        result_ = std::move(t);
-        // std::cout << "in set try: " << t.result() <<std::endl;
-        if (callback_ != nullptr) {
-            state_ = State::DONE;
-            callback_(std::move(result_));
-        }
-        else {
-            state_ = State::CALLBACK;
-        }
-    }
-private:
-    State state_;
-    Result result_;
-    Callback callback_;
-};
-
-class __FutureUnit {
-
-};
-
-template <typename T>
-class Future {
-public:
-    Future() : core_(new Core<T>()) {}
-    explicit Future(Core<T>&& core) : core_(new Core<T>(std::move(core))) {}
-
-    Future(Future&& f) noexcept : core_(std::move(f.core_)) {}
-
-    template <typename Func>
-    auto then(Func&& func) {
-        if constexpr (!std::is_same_v<T, __FutureUnit>)  {
-            using result_type = std::invoke_result_t<Func, T>;
-            Future<result_type> future;
-            get_core()->set_callback([core = future.get_core(), f = std::forward<Func>(func)](Try<T>&& t) mutable {
-                core->set_try(make_try(f(std::move(t).result())));
-            });
-            return future;
-        }
-        else {
-            using result_type = std::invoke_result_t<Func>;
-            Future<result_type> future;
-            get_core()->set_callback([core = future.get_core(), f = std::forward<Func>(func)](Try<T>&& t) mutable {
-                core->set_try(make_try(f()));
-            });
-            return future;
-        }
-    }
-
-    T&& get() noexcept {
-        return (core_->result().result());
-    }
-
-    std::shared_ptr<Core<T>> get_core() const { return core_; }
-private:
-    std::shared_ptr<Core<T>> core_;
-};
-
-template <typename T>
-static Future<T> make_future(T&& t) {
-    return Future<T>(Core<T>(make_try(std::forward<T>(t))));
-}
-
-static Future<__FutureUnit> make_future() {
-    return make_future(__FutureUnit{});
+#include "future.hpp"
+#include "thread_pool.hpp"
+
+#if defined(__cpp_impl_coroutine)
+// the first chain of main as straight-line code
+Task<int> chain_as_task(Future<__FutureUnit> start) {
+    co_await start;
+    std::cout << "in task\n";
+    int n = co_await make_future(10);
+    std::string s = co_await make_future(std::string("hello world from a task"));
+    std::cout << s << ", n: " << n << std::endl;
+    co_return 100;
 }
+#endif
 
 int main() {
     auto future1 = make_future();
@@ -139,6 +39,78 @@ int main() {
     });
     auto result = future2.get();
     std::cout << "result: " << result << "\n";
+
+    // the result arrives from another thread while the chain is attached, the continuations run on the pool
+    tinystl::thread_pool pool(2);
+    Promise<int> promise;
+    auto future3 = promise.get_future().via(pool).then([](int&& n) {
+        return n * 2;
+    }).then([](int&& n) {
+        return std::to_string(n);
+    });
+    std::thread producer([&promise] { promise.set_value(21); });
+    std::cout << "result on pool: " << future3.get() << "\n";
+    producer.join();
+
+    // a promise takes one result, a second one throws instead of running the chain again
+    try {
+        promise.set_value(22);
+    }
+    catch (const std::future_error& e) {
+        std::cout << "second set_value: " << e.what() << "\n";
+    }
+
+    // a throwing stage skips the value continuations after it until on_error recovers
+    auto future4 = make_future(std::string("not a number")).then([](std::string&& s) {
+        return std::stoi(s);
+    }).then([](int&& n) {
+        std::cout << "never printed\n";
+        return n;
+    }).on_error([](std::exception_ptr e) {
+        try {
+            std::rethrow_exception(e);
+        }
+        catch (const std::exception& ex) {
+            std::cout << "recovered from: " << ex.what() << "\n";
+        }
+        return -1;
+    });
+    std::cout << "result after error: " << future4.get() << "\n";
+
+    // a backend that never answers runs into its deadline
+    Promise<int> silent;
+    auto future5 = silent.get_future().within(std::chrono::milliseconds(50)).on_error([](std::error_code e) {
+        std::cout << "deadline: " << e.message() << "\n";
+        return 0;
+    });
+    auto deadline_result = future5.get();
+    std::cout << "result after deadline: " << deadline_result << "\n";
+
+    // cancelling fails a chain whose promise is never kept, the waiter does not hang on it
+    Promise<int> abandoned;
+    CancellationSource source;
+    auto future6 = abandoned.get_future().with_cancellation(source.token()).then([](int&& n) {
+        std::cout << "never printed\n";
+        return n;
+    });
+    std::thread canceller([&source] { source.cancel(); });
+    try {
+        future6.get();
+    }
+    catch (const std::system_error& e) {
+        std::cout << "cancelled: " << e.code().message() << "\n";
+    }
+    canceller.join();
+
+#if defined(__cpp_impl_coroutine)
+    auto task_result = chain_as_task(make_future()).start().get();
+    std::cout << "task result: " << task_result << "\n";
+#endif
+
+#if defined(FUTURE_TRACING)
+    std::ofstream trace("future_trace.json");
+    FutureTrace::dump(trace);
+    std::cout << "stage timeline written to future_trace.json\n";
+#endif
     return 0;
 }
-
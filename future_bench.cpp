@@ -0,0 +1,380 @@
+// g++ -std=c++17 -O2 -pthread future_bench.cpp -o future_bench
+// (-std=c++20 adds the coroutine rows, -DFUTURE_TRACING records every stage; compare the chain rows of both builds)
+// ./future_bench [chain count]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "future.hpp"
+#include "thread_pool.hpp"
+
+// every heap allocation is counted, the chains below should not make any once the block caches are warm
+std::atomic<std::uint64_t> allocation_count{0};
+
+void* operator new(std::size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t size) { return operator new(size); }
+
+// kept out of line: once free is inlined into a delete expression g++ warns that it frees what new returned
+[[gnu::noinline]] void free_allocation(void* p) noexcept { std::free(p); }
+
+void operator delete(void* p) noexcept { free_allocation(p); }
+void operator delete[](void* p) noexcept { free_allocation(p); }
+void operator delete(void* p, std::size_t) noexcept { free_allocation(p); }
+void operator delete[](void* p, std::size_t) noexcept { free_allocation(p); }
+
+template <typename Func>
+double measure_ms(Func&& func) {
+    auto start = std::chrono::steady_clock::now();
+    func();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void report(const std::string& name, double ms, std::size_t count, std::uint64_t allocations, std::uint64_t checksum) {
+    std::cout << name << "\t" << ms * 1e6 / count << " ns/chain\t" << double(allocations) / count << " allocations/chain\tchecksum "
+              << checksum << "\n";
+}
+
+// the value is there before the callbacks are attached, every then runs its callback right away
+std::uint64_t ready_chain(std::uint64_t seed) {
+    return make_future(std::uint64_t(seed)).then([](std::uint64_t&& n) {
+        return n * 3;
+    }).then([](std::uint64_t&& n) {
+        return n + 7;
+    }).then([](std::uint64_t&& n) {
+        return n ^ (n >> 3);
+    }).then([](std::uint64_t&& n) {
+        return n * 5;
+    }).get();
+}
+
+// the callbacks are attached first and the value set afterwards, as with a real producer
+template <typename Executor>
+std::uint64_t pending_chain(std::uint64_t seed, Executor& executor) {
+    Promise<std::uint64_t> promise;
+    auto future = promise.get_future().via(executor).then([](std::uint64_t&& n) {
+        return n * 3;
+    }).then([](std::uint64_t&& n) {
+        return n + 7;
+    }).then([](std::uint64_t&& n) {
+        return n ^ (n >> 3);
+    }).then([](std::uint64_t&& n) {
+        return n * 5;
+    });
+    promise.set_value(std::move(seed));
+    return future.get();
+}
+
+// the first stage fails, the other three are skipped and on_error recovers; error_code never throws
+template <bool Throw>
+std::uint64_t failing_chain(std::uint64_t seed) {
+    return make_future(std::uint64_t(seed)).then([](std::uint64_t&& n) {
+        if constexpr (Throw) {
+            throw std::runtime_error("failed");
+            return n;
+        }
+        else {
+            return Try<std::uint64_t>(std::make_error_code(std::errc::timed_out));
+        }
+    }).then([](std::uint64_t&& n) {
+        return n + 7;
+    }).then([](std::uint64_t&& n) {
+        return n ^ (n >> 3);
+    }).on_error([seed](auto) {
+        return seed;
+    }).get();
+}
+
+#if defined(__cpp_impl_coroutine)
+Task<std::uint64_t> stage(std::uint64_t n) {
+    co_return n + 7;
+}
+
+// the stages of pending_chain as one coroutine awaiting the producer's future and a child task
+Task<std::uint64_t> task_chain(Future<std::uint64_t> future) {
+    std::uint64_t n = co_await future;
+    n = co_await stage(n * 3);
+    n = n ^ (n >> 3);
+    co_return n * 5;
+}
+
+// unoptimised g++ pairs the arena operator new with the frame's sized delete and warns, though the frame
+// header routes the block back to the arena
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+Task<std::uint64_t> arena_stage(std::allocator_arg_t, FrameArena&, std::uint64_t n) {
+    co_return n + 7;
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+template <typename Chain>
+void chain_bench(const std::string& name, std::size_t count, Chain&& chain) {
+    std::uint64_t checksum = chain(0);
+    std::uint64_t before = allocation_count.load();
+    double ms = measure_ms([&] {
+        for (std::size_t i = 0; i < count; ++i) {
+            checksum += chain(i);
+        }
+    });
+    report(name, ms, count, allocation_count.load() - before, checksum);
+}
+
+// per-request deadlines: every request gets within(), the reply comes in time and cancels the timer
+void deadline_bench(std::size_t count) {
+    std::uint64_t checksum = 0;
+    std::vector<Promise<std::uint64_t>> promises(count);
+    std::vector<Future<std::uint64_t>> futures;
+    futures.reserve(count);
+    double ms = measure_ms([&] {
+        for (auto& promise : promises) {
+            futures.push_back(promise.get_future().within(std::chrono::seconds(10)));
+        }
+        for (std::size_t i = 0; i < count; ++i) {
+            promises[i].set_value(i);
+        }
+        for (auto& future : futures) {
+            checksum += future.get();
+        }
+    });
+    std::cout << "within(10s), answered in time\t" << ms * 1e6 / count << " ns/request\t" << count / ms * 1e3
+              << " requests/s\tchecksum " << checksum << "\n";
+
+    // a million outstanding timers at once, then all cancelled
+    std::vector<TimerWheel::Timer*> timers(count);
+    auto& wheel = TimerWheel::default_wheel();
+    double schedule_ms = measure_ms([&] {
+        for (auto& timer : timers) {
+            timer = wheel.schedule(std::chrono::seconds(10), [](void*) {}, nullptr);
+        }
+    });
+    double cancel_ms = measure_ms([&] {
+        for (auto* timer : timers) {
+            wheel.cancel(timer);
+        }
+    });
+    std::cout << "TimerWheel\t" << schedule_ms * 1e6 / count << " ns/schedule\t" << cancel_ms * 1e6 / count << " ns/cancel\n";
+
+    // requests that miss their deadline
+    std::size_t late = std::min<std::size_t>(count, 10000);
+    std::vector<Promise<std::uint64_t>> silent(late);
+    std::size_t timeouts = 0;
+    ms = measure_ms([&] {
+        std::vector<Future<std::uint64_t>> waiting;
+        for (auto& promise : silent) {
+            waiting.push_back(promise.get_future().within(std::chrono::milliseconds(5)));
+        }
+        for (auto& future : waiting) {
+            try {
+                future.get();
+            }
+            catch (const std::system_error&) {
+                ++timeouts;
+            }
+        }
+    });
+    std::cout << "within(5ms), never answered\t" << late << " requests\t" << ms << " ms until all timed out\t" << timeouts << " timeouts\n";
+}
+
+// what collect_all replaces: a mutex, a growing vector and a shared_ptr per call
+template <typename T>
+struct MutexCollectState {
+    std::mutex mutex;
+    std::vector<std::pair<std::size_t, Try<T>>> results;
+    std::size_t remaining;
+    Promise<std::vector<std::pair<std::size_t, Try<T>>>> promise;
+};
+
+template <typename T>
+Future<std::vector<std::pair<std::size_t, Try<T>>>> mutex_collect_all(std::vector<Future<T>>& futures) {
+    auto state = std::make_shared<MutexCollectState<T>>();
+    state->remaining = futures.size();
+    auto future = state->promise.get_future();
+    for (std::size_t i = 0; i < futures.size(); ++i) {
+        futures[i].get_core()->set_callback([state, i](Try<T>&& t) {
+            std::unique_lock<std::mutex> lock(state->mutex);
+            state->results.emplace_back(i, std::move(t));
+            if (--state->remaining == 0) {
+                lock.unlock();
+                std::sort(state->results.begin(), state->results.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+                state->promise.set_value(std::move(state->results));
+            }
+        });
+    }
+    return future;
+}
+
+// one request fans out to width backends whose replies arrive on a pool thread; the time runs from creating
+// the promises until the combined future is ready on the requesting thread
+template <typename Collect>
+void fan_out_bench(const std::string& name, std::size_t width, std::size_t rounds, tinystl::thread_pool& backend, Collect&& collect) {
+    std::uint64_t checksum = 0;
+    double ms = measure_ms([&] {
+        for (std::size_t round = 0; round < rounds; ++round) {
+            // the backend owns the promises, collect_any and collect_n finish before it has answered them all
+            auto promises = std::make_shared<std::vector<Promise<std::uint64_t>>>(width);
+            std::vector<Future<std::uint64_t>> futures;
+            futures.reserve(width);
+            for (auto& promise : *promises) {
+                futures.push_back(promise.get_future());
+            }
+            auto combined = collect(futures);
+            backend.submit([promises, round] {
+                for (std::size_t i = 0; i < promises->size(); ++i) {
+                    (*promises)[i].set_value(round + i);
+                }
+            });
+            checksum += combined.get();
+        }
+    });
+    std::cout << name << "\t" << width << " futures\t" << ms * 1e3 / rounds << " us/fan-out\t" << ms * 1e6 / (rounds * width)
+              << " ns/future\tchecksum " << checksum << "\n";
+}
+
+// two threads hand a value back and forth through fresh promise/future pairs, each side blocked in get() until
+// the other answers; a round trip is two hand-offs and two wake-ups
+template <template <typename> class PromiseType>
+double ping_pong_ns(std::size_t rounds, std::uint64_t& checksum) {
+    std::vector<PromiseType<std::uint64_t>> pings(rounds);
+    std::vector<PromiseType<std::uint64_t>> pongs(rounds);
+    std::vector<decltype(pings[0].get_future())> ping_futures;
+    std::vector<decltype(pongs[0].get_future())> pong_futures;
+    for (std::size_t i = 0; i < rounds; ++i) {
+        ping_futures.push_back(pings[i].get_future());
+        pong_futures.push_back(pongs[i].get_future());
+    }
+    std::thread partner([&] {
+        for (std::size_t i = 0; i < rounds; ++i) {
+            pongs[i].set_value(ping_futures[i].get() + 1);
+        }
+    });
+    double ms = measure_ms([&] {
+        for (std::size_t i = 0; i < rounds; ++i) {
+            pings[i].set_value(std::uint64_t(i));
+            checksum += pong_futures[i].get();
+        }
+    });
+    partner.join();
+    return ms * 1e6 / rounds;
+}
+
+void blocking_bench(std::size_t count) {
+    std::uint64_t checksum = 0;
+    auto ready = make_future(std::uint64_t(42));
+    double ms = measure_ms([&] {
+        for (std::size_t i = 0; i < count; ++i) {
+            ready.wait();
+            checksum += ready.ready();
+        }
+    });
+    std::cout << "wait() on a ready future\t" << ms * 1e6 / count << " ns/wait\n";
+
+    std::size_t rounds = std::max<std::size_t>(count / 10, 1);
+    double future_ns = ping_pong_ns<Promise>(rounds, checksum);
+    double std_ns = ping_pong_ns<std::promise>(rounds, checksum);
+    std::cout << "ping-pong, Future::get\t" << future_ns << " ns/round trip\n";
+    std::cout << "ping-pong, std::future::get\t" << std_ns << " ns/round trip\tchecksum " << checksum << "\n";
+}
+
+int main(int argc, char** argv) {
+    std::size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+
+    std::cout << count << " four-stage then chains\n";
+    chain_bench("ready value, inline", count, [](std::uint64_t seed) { return ready_chain(seed); });
+    InlineExecutor inline_executor;
+    chain_bench("pending value, InlineExecutor", count, [&](std::uint64_t seed) { return pending_chain(seed, inline_executor); });
+#if defined(__cpp_impl_coroutine)
+    chain_bench("pending value, Task", count, [](std::uint64_t seed) {
+        Promise<std::uint64_t> promise;
+        auto future = task_chain(promise.get_future()).start();
+        promise.set_value(std::move(seed));
+        return future.get();
+    });
+    FrameArena arena(1 << 20);
+    chain_bench("ready value, Task in FrameArena", count, [&arena](std::uint64_t seed) {
+        arena.reset();
+        return arena_stage(std::allocator_arg, arena, seed).start().get();
+    });
+#endif
+    chain_bench("error_code failure, inline", count, [](std::uint64_t seed) { return failing_chain<false>(seed); });
+    chain_bench("thrown exception, inline", count / 10, [](std::uint64_t seed) { return failing_chain<true>(seed); });
+    // the pool's std::deque and its wake-up path allocate on their own, shown for reference
+    tinystl::thread_pool pool(1);
+    chain_bench("pending value, thread_pool", count / 10, [&](std::uint64_t seed) { return pending_chain(seed, pool); });
+#if defined(FUTURE_TRACING)
+    double trace_ms = measure_ms([&] {
+        for (std::size_t i = 0; i < count; ++i) {
+            FutureTrace::record(FutureTrace::next_id(), FutureTrace::VALUE_SET);
+        }
+    });
+    std::cout << "tracing compiled in\t" << trace_ms * 1e6 / count << " ns/event\n";
+    FutureTrace::sample_every(16);
+    chain_bench("ready value, 1 in 16 stages traced", count, [](std::uint64_t seed) { return ready_chain(seed); });
+    chain_bench("pending value, 1 in 16 stages traced", count, [&](std::uint64_t seed) { return pending_chain(seed, inline_executor); });
+    FutureTrace::sample_every(1);
+#endif
+
+    std::cout << "\nblocking waits between two threads\n";
+    blocking_bench(count);
+
+    std::cout << "\n" << count << " requests with deadlines\n";
+    deadline_bench(count);
+
+    for (std::size_t width : { 1000, 10000 }) {
+        std::size_t rounds = std::max<std::size_t>(count / 100 / width, 10);
+        std::cout << "\nfan-out to " << width << " futures, " << rounds << " rounds\n";
+        fan_out_bench("collect_all", width, rounds, pool, [](std::vector<Future<std::uint64_t>>& futures) {
+            return collect_all(futures.begin(), futures.end()).then([](std::vector<Try<std::uint64_t>>&& results) {
+                return results.back().result();
+            });
+        });
+        fan_out_bench("mutex + vector", width, rounds, pool, [](std::vector<Future<std::uint64_t>>& futures) {
+            return mutex_collect_all(futures).then([](std::vector<std::pair<std::size_t, Try<std::uint64_t>>>&& results) {
+                return results.back().second.result();
+            });
+        });
+        fan_out_bench("collect_any", width, rounds, pool, [](std::vector<Future<std::uint64_t>>& futures) {
+            return collect_any(futures.begin(), futures.end()).then([](std::pair<std::size_t, Try<std::uint64_t>>&& first) {
+                return std::uint64_t(first.first);
+            });
+        });
+        fan_out_bench("collect_n(half)", width, rounds, pool, [](std::vector<Future<std::uint64_t>>& futures) {
+            return collect_n(futures.begin(), futures.end(), futures.size() / 2).then([](std::vector<std::pair<std::size_t, Try<std::uint64_t>>>&& results) {
+                return std::uint64_t(results.size());
+            });
+        });
+        // window over backends that answer on the spot, which is its bookkeeping cost alone
+        std::uint64_t checksum = 0;
+        double ms = measure_ms([&] {
+            for (std::size_t round = 0; round < rounds; ++round) {
+                std::vector<std::uint64_t> inputs(width, round);
+                auto futures = window(std::move(inputs), [](std::uint64_t&& x) { return make_future(std::move(x)); }, 64);
+                checksum += futures.back().get();
+            }
+        });
+        std::cout << "window(64)\t" << width << " futures\t" << ms * 1e3 / rounds << " us/fan-out\t" << ms * 1e6 / (rounds * width)
+                  << " ns/future\tchecksum " << checksum << "\n";
+    }
+    return 0;
+}
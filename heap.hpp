@@ -0,0 +1,237 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace tinystl {
+
+// d-ary heap algorithms: the root holds the element that comes first under compare, so the default
+// less_equal gives a min-heap; wider nodes (4 or 8 children) make the tree shallower and keep the
+// children of a node in one or two cache lines
+namespace detail {
+
+template <std::size_t Arity, typename Iterator, typename Compare>
+void heap_sift_up(Iterator first, typename std::iterator_traits<Iterator>::difference_type hole, Compare& compare) {
+    auto value = std::move(*(first + hole));
+    while (hole > 0) {
+        auto parent = (hole - 1) / static_cast<decltype(hole)>(Arity);
+        if (!compare(value, *(first + parent))) {
+            break;
+        }
+        *(first + hole) = std::move(*(first + parent));
+        hole = parent;
+    }
+    *(first + hole) = std::move(value);
+}
+
+template <std::size_t Arity, typename Iterator, typename Compare>
+void heap_sift_down(Iterator first, typename std::iterator_traits<Iterator>::difference_type len,
+                    typename std::iterator_traits<Iterator>::difference_type hole, Compare& compare) {
+    using difference_type = typename std::iterator_traits<Iterator>::difference_type;
+    auto value = std::move(*(first + hole));
+    while (true) {
+        difference_type child = hole * static_cast<difference_type>(Arity) + 1;
+        if (child >= len) {
+            break;
+        }
+        difference_type child_last = std::min(child + static_cast<difference_type>(Arity), len);
+        difference_type best = child;
+        for (++child; child < child_last; ++child) {
+            if (compare(*(first + child), *(first + best))) {
+                best = child;
+            }
+        }
+        if (!compare(*(first + best), value)) {
+            break;
+        }
+        *(first + hole) = std::move(*(first + best));
+        hole = best;
+    }
+    *(first + hole) = std::move(value);
+}
+
+}
+
+template <std::size_t Arity = 4, typename Iterator, typename Compare = std::less_equal<typename std::iterator_traits<Iterator>::value_type>>
+void make_heap(Iterator first, Iterator last, Compare compare = Compare{}) {
+    static_assert(Arity >= 2, "a heap needs at least two children per node");
+    auto len = last - first;
+    for (auto hole = len > 1 ? (len - 2) / static_cast<decltype(len)>(Arity) + 1 : 0; hole > 0; --hole) {
+        detail::heap_sift_down<Arity>(first, len, hole - 1, compare);
+    }
+}
+
+// [first, last - 1) is a heap and *(last - 1) is the new element
+template <std::size_t Arity = 4, typename Iterator, typename Compare = std::less_equal<typename std::iterator_traits<Iterator>::value_type>>
+void push_heap(Iterator first, Iterator last, Compare compare = Compare{}) {
+    if (last - first > 1) {
+        detail::heap_sift_up<Arity>(first, last - first - 1, compare);
+    }
+}
+
+// moves the root to *(last - 1) and restores the heap on [first, last - 1)
+template <std::size_t Arity = 4, typename Iterator, typename Compare = std::less_equal<typename std::iterator_traits<Iterator>::value_type>>
+void pop_heap(Iterator first, Iterator last, Compare compare = Compare{}) {
+    if (last - first > 1) {
+        std::swap(*first, *(last - 1));
+        detail::heap_sift_down<Arity>(first, last - first - 1, 0, compare);
+    }
+}
+
+// in-place heap sort: the heap is built with the order flipped so popping moves the largest element to the back
+template <std::size_t Arity = 4, typename Iterator, typename Compare = std::less_equal<typename std::iterator_traits<Iterator>::value_type>>
+void heap_sort(Iterator first, Iterator last, Compare compare = Compare{}) {
+    static_assert(std::is_same<typename std::iterator_traits<Iterator>::iterator_category, std::random_access_iterator_tag>::value, "only allow random iterator");
+    auto flipped = [&compare](const auto& a, const auto& b) { return compare(b, a); };
+    tinystl::make_heap<Arity>(first, last, flipped);
+    for (; last - first > 1; --last) {
+        tinystl::pop_heap<Arity>(first, last, flipped);
+    }
+}
+
+// addressable d-ary priority queue: push returns a handle that stays valid until its element is popped,
+// so a queued element can later be moved towards the top with decrease_key or anywhere with update
+template <typename T, typename Compare = std::less_equal<T>, std::size_t Arity = 4>
+class priority_queue {
+public:
+    using value_type = T;
+    using handle = std::size_t;
+
+    explicit priority_queue(Compare compare = Compare{}) : compare_(std::move(compare)) {}
+
+    bool empty() const noexcept { return heap_.empty(); }
+    std::size_t size() const noexcept { return heap_.size(); }
+
+    void reserve(std::size_t capacity) {
+        heap_.reserve(capacity);
+        positions_.reserve(capacity);
+    }
+
+    const T& top() const { return heap_.front().value; }
+    handle top_handle() const { return heap_.front().id; }
+    const T& value(handle h) const { return heap_[positions_[h]].value; }
+    bool contains(handle h) const { return h < positions_.size() && positions_[h] != npos; }
+
+    handle push(T value) {
+        handle id;
+        if (free_.empty()) {
+            id = positions_.size();
+            positions_.push_back(heap_.size());
+        }
+        else {
+            id = free_.back();
+            free_.pop_back();
+            positions_[id] = heap_.size();
+        }
+        heap_.push_back(node{ std::move(value), id });
+        sift_up(heap_.size() - 1);
+        return id;
+    }
+
+    void pop() {
+        positions_[heap_.front().id] = npos;
+        free_.push_back(heap_.front().id);
+        if (heap_.size() > 1) {
+            // the last leaf nearly always sinks back to the bottom, so walk the hole down to a leaf
+            // without comparing against it and sift the leaf up from there
+            std::size_t hole = 0;
+            std::size_t len = heap_.size() - 1;
+            for (std::size_t child = 1; child < len; child = hole * Arity + 1) {
+                std::size_t best = min_child(child, std::min(child + Arity, len));
+                place(hole, std::move(heap_[best]));
+                hole = best;
+            }
+            place(hole, std::move(heap_.back()));
+            heap_.pop_back();
+            sift_up(hole);
+        }
+        else {
+            heap_.pop_back();
+        }
+    }
+
+    // value must not come after the current value of h under compare
+    void decrease_key(handle h, T value) {
+        heap_[positions_[h]].value = std::move(value);
+        sift_up(positions_[h]);
+    }
+
+    void update(handle h, T value) {
+        std::size_t index = positions_[h];
+        heap_[index].value = std::move(value);
+        if (index > 0 && compare_(heap_[index].value, heap_[(index - 1) / Arity].value)) {
+            sift_up(index);
+        }
+        else {
+            sift_down(index);
+        }
+    }
+
+private:
+    struct node {
+        T value;
+        handle id;
+    };
+
+    static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+    // the heap is sifted with a hole, every node that moves writes its new index back to positions_
+    void place(std::size_t index, node&& n) {
+        positions_[n.id] = index;
+        heap_[index] = std::move(n);
+    }
+
+    std::size_t min_child(std::size_t child, std::size_t child_last) const {
+        std::size_t best = child;
+        for (++child; child < child_last; ++child) {
+            if (compare_(heap_[child].value, heap_[best].value)) {
+                best = child;
+            }
+        }
+        return best;
+    }
+
+    void sift_up(std::size_t hole) {
+        node n = std::move(heap_[hole]);
+        while (hole > 0) {
+            std::size_t parent = (hole - 1) / Arity;
+            if (!compare_(n.value, heap_[parent].value)) {
+                break;
+            }
+            place(hole, std::move(heap_[parent]));
+            hole = parent;
+        }
+        place(hole, std::move(n));
+    }
+
+    void sift_down(std::size_t hole) {
+        node n = std::move(heap_[hole]);
+        std::size_t len = heap_.size();
+        while (true) {
+            std::size_t child = hole * Arity + 1;
+            if (child >= len) {
+                break;
+            }
+            std::size_t best = min_child(child, std::min(child + Arity, len));
+            if (!compare_(heap_[best].value, n.value)) {
+                break;
+            }
+            place(hole, std::move(heap_[best]));
+            hole = best;
+        }
+        place(hole, std::move(n));
+    }
+
+    std::vector<node> heap_;
+    std::vector<std::size_t> positions_;
+    std::vector<handle> free_;
+    Compare compare_;
+};
+
+}
@@ -0,0 +1,163 @@
+// g++ -std=c++17 -O2 heap_bench.cpp -o heap_bench
+// ./heap_bench [element count]
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "heap.hpp"
+
+template <typename Func>
+double measure_ms(Func&& func) {
+    auto start = std::chrono::steady_clock::now();
+    func();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void report(const std::string& name, double ms, std::size_t count, std::uint64_t checksum) {
+    std::cout << name << "\t" << ms << " ms\t" << ms * 1e6 / count << " ns/op\tchecksum " << checksum << "\n";
+}
+
+// push everything, then pop everything
+template <std::size_t Arity>
+void push_pop_bench(const std::vector<std::uint64_t>& input) {
+    std::uint64_t checksum = 0;
+    double ms = measure_ms([&] {
+        tinystl::priority_queue<std::uint64_t, std::less<std::uint64_t>, Arity> queue;
+        for (auto value : input) {
+            queue.push(value);
+        }
+        while (!queue.empty()) {
+            checksum = checksum * 31 + queue.top();
+            queue.pop();
+        }
+    });
+    report("tinystl::priority_queue<" + std::to_string(Arity) + ">", ms, input.size(), checksum);
+}
+
+// a Dijkstra-like workload: keys only ever shrink, std::priority_queue has to push duplicates and skip stale entries
+template <std::size_t Arity>
+void decrease_key_bench(const std::vector<std::uint64_t>& input, const std::vector<std::uint64_t>& updates) {
+    std::uint64_t checksum = 0;
+    double ms = measure_ms([&] {
+        tinystl::priority_queue<std::uint64_t, std::less<std::uint64_t>, Arity> queue;
+        std::vector<typename tinystl::priority_queue<std::uint64_t, std::less<std::uint64_t>, Arity>::handle> handles;
+        handles.reserve(input.size());
+        for (auto value : input) {
+            handles.push_back(queue.push(value));
+        }
+        for (std::size_t i = 0; i < updates.size(); ++i) {
+            auto h = handles[updates[i] % handles.size()];
+            if (queue.contains(h) && queue.value(h) > updates[i] >> 1) {
+                queue.decrease_key(h, updates[i] >> 1);
+            }
+            if (i % 4 == 0) {
+                checksum = checksum * 31 + queue.top();
+                queue.pop();
+            }
+        }
+    });
+    report("tinystl::priority_queue<" + std::to_string(Arity) + ">::decrease_key", ms, updates.size(), checksum);
+}
+
+void std_decrease_key_bench(const std::vector<std::uint64_t>& input, const std::vector<std::uint64_t>& updates) {
+    std::uint64_t checksum = 0;
+    double ms = measure_ms([&] {
+        using entry = std::pair<std::uint64_t, std::size_t>;
+        std::priority_queue<entry, std::vector<entry>, std::greater<entry>> queue;
+        std::vector<std::uint64_t> keys = input;
+        std::vector<bool> popped(input.size());
+        for (std::size_t i = 0; i < input.size(); ++i) {
+            queue.emplace(input[i], i);
+        }
+        auto skip_stale = [&] {
+            while (queue.top().first != keys[queue.top().second] || popped[queue.top().second]) {
+                queue.pop();
+            }
+        };
+        for (std::size_t i = 0; i < updates.size(); ++i) {
+            std::size_t index = updates[i] % input.size();
+            if (!popped[index] && keys[index] > updates[i] >> 1) {
+                keys[index] = updates[i] >> 1;
+                queue.emplace(keys[index], index);
+            }
+            if (i % 4 == 0) {
+                skip_stale();
+                checksum = checksum * 31 + queue.top().first;
+                popped[queue.top().second] = true;
+                queue.pop();
+            }
+        }
+    });
+    report("std::priority_queue(lazy deletion)", ms, updates.size(), checksum);
+}
+
+int main(int argc, char** argv) {
+    std::size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+
+    std::mt19937_64 engine(42);
+    std::vector<std::uint64_t> input(count);
+    for (auto& value : input) {
+        value = engine();
+    }
+    std::vector<std::uint64_t> updates(count);
+    for (auto& value : updates) {
+        value = engine();
+    }
+
+    std::cout << count << " uint64 keys, push then pop\n";
+    push_pop_bench<2>(input);
+    push_pop_bench<4>(input);
+    push_pop_bench<8>(input);
+    {
+        std::uint64_t checksum = 0;
+        double ms = measure_ms([&] {
+            std::priority_queue<std::uint64_t, std::vector<std::uint64_t>, std::greater<std::uint64_t>> queue;
+            for (auto value : input) {
+                queue.push(value);
+            }
+            while (!queue.empty()) {
+                checksum = checksum * 31 + queue.top();
+                queue.pop();
+            }
+        });
+        report("std::priority_queue", ms, count, checksum);
+    }
+
+    std::cout << count << " uint64 keys, " << count << " decrease_key with a pop every 4th\n";
+    decrease_key_bench<2>(input, updates);
+    decrease_key_bench<4>(input, updates);
+    std_decrease_key_bench(input, updates);
+
+    std::cout << count << " uint64 keys, heap sort\n";
+    for (std::size_t arity : { 2, 4, 8 }) {
+        auto data = input;
+        double ms = measure_ms([&] {
+            if (arity == 2) {
+                tinystl::heap_sort<2>(data.begin(), data.end(), std::less<std::uint64_t>{});
+            }
+            else if (arity == 4) {
+                tinystl::heap_sort<4>(data.begin(), data.end(), std::less<std::uint64_t>{});
+            }
+            else {
+                tinystl::heap_sort<8>(data.begin(), data.end(), std::less<std::uint64_t>{});
+            }
+        });
+        report("tinystl::heap_sort<" + std::to_string(arity) + ">", ms, count, std::is_sorted(data.begin(), data.end()));
+    }
+    {
+        auto data = input;
+        double ms = measure_ms([&] {
+            std::make_heap(data.begin(), data.end());
+            std::sort_heap(data.begin(), data.end());
+        });
+        report("std::make_heap + std::sort_heap", ms, count, std::is_sorted(data.begin(), data.end()));
+    }
+    return 0;
+}
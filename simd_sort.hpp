@@ -0,0 +1,202 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
+// bitonic sorting networks for 8/16/32/64 int32/int64/float/double elements, written once with gcc vector
+// extensions and instantiated per instruction set (SSE4.2, AVX2, AVX-512) behind a runtime CPU check
+#if defined(__GNUC__) && !defined(__clang__) && (defined(__x86_64__) || defined(__i386__))
+#define TINYSTL_SIMD_SORT 1
+#endif
+
+namespace tinystl {
+namespace simd {
+
+template <typename T>
+struct is_network_type : std::integral_constant<bool,
+    std::is_same<T, std::int32_t>::value || std::is_same<T, std::int64_t>::value ||
+    std::is_same<T, float>::value || std::is_same<T, double>::value> {};
+
+constexpr std::size_t max_network_size = 64;
+
+#ifdef TINYSTL_SIMD_SORT
+
+namespace detail {
+
+template <typename T, std::size_t Bytes>
+struct vector_types {
+    using lane_index = typename std::conditional<sizeof(T) == 4, std::int32_t, std::int64_t>::type;
+    typedef T vec __attribute__((vector_size(Bytes)));
+    typedef lane_index index __attribute__((vector_size(Bytes)));
+    static constexpr std::size_t lanes = Bytes / sizeof(T);
+};
+
+// compare-exchange inside one register: lanes are paired through a shuffle and the upper lane of each pair keeps the max
+template <typename Types, std::size_t... Lanes, typename Partner, typename TakesMax>
+__attribute__((always_inline)) inline void exchange_lanes(typename Types::vec& v, std::index_sequence<Lanes...>, Partner partner, TakesMax takes_max) {
+    using index = typename Types::index;
+    const index shuffle = { static_cast<typename Types::lane_index>(partner(Lanes))... };
+    const index upper = { static_cast<typename Types::lane_index>(takes_max(Lanes) ? -1 : 0)... };
+    typename Types::vec other = __builtin_shuffle(v, shuffle);
+    typename Types::vec lo = v < other ? v : other;
+    typename Types::vec hi = v < other ? other : v;
+    v = upper ? hi : lo;
+}
+
+template <typename Types, std::size_t... Lanes>
+__attribute__((always_inline)) inline void reverse_lanes(typename Types::vec& v, std::index_sequence<Lanes...>) {
+    const typename Types::index shuffle = { static_cast<typename Types::lane_index>(Types::lanes - 1 - Lanes)... };
+    v = __builtin_shuffle(v, shuffle);
+}
+
+// distance steps of a bitonic merge: pair i with i + Distance inside blocks of 2 * Distance
+template <typename Types, std::size_t Registers, std::size_t Distance>
+__attribute__((always_inline)) inline void distance_steps(typename Types::vec (&v)[Registers]) {
+    constexpr std::size_t W = Types::lanes;
+    if constexpr (Distance >= W) {
+        constexpr std::size_t stride = Distance / W;
+        for (std::size_t r = 0; r < Registers; ++r) {
+            if ((r & stride) == 0) {
+                auto a = v[r];
+                auto b = v[r + stride];
+                v[r] = a < b ? a : b;
+                v[r + stride] = a < b ? b : a;
+            }
+        }
+    }
+    else {
+        for (std::size_t r = 0; r < Registers; ++r) {
+            exchange_lanes<Types>(v[r], std::make_index_sequence<W>{},
+                                  [](std::size_t lane) { return lane ^ Distance; },
+                                  [](std::size_t lane) { return (lane & Distance) != 0; });
+        }
+    }
+    if constexpr (Distance > 1) {
+        distance_steps<Types, Registers, Distance / 2>(v);
+    }
+}
+
+// merges sorted runs of Merge / 2 into runs of Merge, the first step pairs i with Merge - 1 - i so no direction flags are needed
+template <typename Types, std::size_t Registers, std::size_t Merge>
+__attribute__((always_inline)) inline void merge_steps(typename Types::vec (&v)[Registers]) {
+    constexpr std::size_t W = Types::lanes;
+    if constexpr (Merge <= W) {
+        for (std::size_t r = 0; r < Registers; ++r) {
+            exchange_lanes<Types>(v[r], std::make_index_sequence<W>{},
+                                  [](std::size_t lane) { return lane - lane % Merge + Merge - 1 - lane % Merge; },
+                                  [](std::size_t lane) { return lane % Merge >= Merge / 2; });
+        }
+    }
+    else {
+        constexpr std::size_t block = Merge / W;
+        for (std::size_t base = 0; base < Registers; base += block) {
+            for (std::size_t k = 0; k < block / 2; ++k) {
+                auto a = v[base + k];
+                auto b = v[base + block - 1 - k];
+                reverse_lanes<Types>(b, std::make_index_sequence<W>{});
+                v[base + k] = a < b ? a : b;
+                v[base + block - 1 - k] = a < b ? b : a;
+                reverse_lanes<Types>(v[base + block - 1 - k], std::make_index_sequence<W>{});
+            }
+        }
+    }
+    if constexpr (Merge >= 4) {
+        distance_steps<Types, Registers, Merge / 4>(v);
+    }
+    if constexpr (Merge * 2 <= Registers * W) {
+        merge_steps<Types, Registers, Merge * 2>(v);
+    }
+}
+
+template <typename T, std::size_t Bytes, std::size_t N>
+__attribute__((always_inline)) inline void bitonic_sort(T* data) {
+    using types = vector_types<T, (Bytes < N * sizeof(T) ? Bytes : N * sizeof(T))>;
+    constexpr std::size_t registers = N / types::lanes;
+    typename types::vec v[registers];
+    std::memcpy(v, data, sizeof(v));
+    merge_steps<types, registers, 2>(v);
+    std::memcpy(data, v, sizeof(v));
+}
+
+template <typename T, std::size_t N>
+__attribute__((target("avx512f"))) void bitonic_sort_avx512(T* data) { bitonic_sort<T, 64, N>(data); }
+
+template <typename T, std::size_t N>
+__attribute__((target("avx2"))) void bitonic_sort_avx2(T* data) { bitonic_sort<T, 32, N>(data); }
+
+template <typename T, std::size_t N>
+__attribute__((target("sse4.2"))) void bitonic_sort_sse4(T* data) { bitonic_sort<T, 16, N>(data); }
+
+template <typename T>
+using kernel = void (*)(T*);
+
+template <typename T>
+struct kernel_table {
+    kernel<T> kernels[4];
+};
+
+template <typename T>
+kernel_table<T> select_kernels() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return { { bitonic_sort_avx512<T, 8>, bitonic_sort_avx512<T, 16>, bitonic_sort_avx512<T, 32>, bitonic_sort_avx512<T, 64> } };
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return { { bitonic_sort_avx2<T, 8>, bitonic_sort_avx2<T, 16>, bitonic_sort_avx2<T, 32>, bitonic_sort_avx2<T, 64> } };
+    }
+    if (__builtin_cpu_supports("sse4.2")) {
+        return { { bitonic_sort_sse4<T, 8>, bitonic_sort_sse4<T, 16>, bitonic_sort_sse4<T, 32>, bitonic_sort_sse4<T, 64> } };
+    }
+    return { { nullptr, nullptr, nullptr, nullptr } };
+}
+
+template <typename T>
+const kernel_table<T>& kernels() {
+    static const kernel_table<T> table = select_kernels<T>();
+    return table;
+}
+
+}
+
+// sorts up to 64 elements ascending in a sorting network padded to the next power of two,
+// returns false when the type or the CPU has no network and the caller has to sort on its own
+template <typename T>
+bool sort_small(T* data, std::size_t n) {
+    if constexpr (!is_network_type<T>::value) {
+        return false;
+    }
+    else {
+        if (n > max_network_size) {
+            return false;
+        }
+        std::size_t slot = n <= 8 ? 0 : n <= 16 ? 1 : n <= 32 ? 2 : 3;
+        auto kernel = detail::kernels<T>().kernels[slot];
+        if (kernel == nullptr) {
+            return false;
+        }
+        alignas(64) T buffer[max_network_size];
+        std::size_t size = std::size_t(8) << slot;
+        std::copy(data, data + n, buffer);
+        std::fill(buffer + n, buffer + size, std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity() : std::numeric_limits<T>::max());
+        kernel(buffer);
+        std::copy(buffer, buffer + n, data);
+        return true;
+    }
+}
+
+#else
+
+template <typename T>
+bool sort_small(T*, std::size_t) {
+    return false;
+}
+
+#endif
+
+}
+}
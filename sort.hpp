@@ -1,462 +1,1517 @@
-#include <cmath>
-#include <algorithm>
-#include <iterator>
-#include <vector>
-#include <type_traits>
-#include <functional>
-namespace tinystl {
-
-using std::vector;
-
-template <typename Iterator, typename Compare = std::less_equal<typename std::iterator_traits<Iterator>::value_type>>
-void insert_sort(Iterator first, Iterator last, Compare compare = Compare{}) {
-    static_assert(std::is_same<typename std::iterator_traits<Iterator>::iterator_category, std::random_access_iterator_tag>::value, "only allow random iterator");
-    auto cur = first;
-    while (cur != last) {
-        auto value = *cur;
-        auto next = cur + 1;
-        auto prev = cur - 1;
-        while (cur > first && compare(value, *prev)) {
-            *cur = *prev;
-            --cur;
-            --prev;
-        }
-        *cur = value;
-        cur = next;
-    }
-}
-
-template <typename Iterator, typename Compare = std::less_equal<typename std::iterator_traits<Iterator>::value_type>>
-void enable_midian(Iterator first, Iterator last, Compare compare) {
-    static_assert(std::is_same<typename std::iterator_traits<Iterator>::iterator_category, std::random_access_iterator_tag>::value, "only allow random iterator");
-    auto middle = first + (last - first) / 2;
-    --last;
-    if (compare(*middle, *first)) {
-        std::swap(*middle, *first);
-    }
-    if (compare(*last, *first)) {
-        std::swap(*last, *first);
-    }
-    if (compare(*last, *middle)) {
-        std::swap(*middle, *last);
-    }
-    std::swap(*first, *middle);
-}
-
-template <typename Iterator, typename Compare = std::less_equal<typename std::iterator_traits<Iterator>::value_type>>
-void quick_sort(Iterator first, Iterator last, Compare compare = Compare{}) {
-    static_assert(std::is_same<typename std::iterator_traits<Iterator>::iterator_category, std::random_access_iterator_tag>::value, "only allow random iterator");
-    if (first == last || first + 1 == last) {
-        return;
-    }
-    if (last - first <= 10) {
-        insert_sort(first, last, compare);
-        return;
-    }
-    enable_midian(first, last, compare);
-    auto pivot = *first;
-    auto f = first;
-    auto l = last;
-    --last;
-
-    int left_pivot_size = 0;
-    int right_pivot_size = 0;
-    while (first < last) {
-        while (first < last && (!compare(*last, pivot) || (compare(*last, pivot) && compare(pivot, *last)))) {
-            if (compare(*last, pivot) && compare(pivot, *last)) {
-                std::swap(*last, *(l - right_pivot_size++ - 1));
-            }
-            --last;
-        }
-        if (first < last) {
-            std::swap(*(first++), *last);
-        }
-        while (first < last && compare(*first, pivot)) {
-            if (compare(*first, pivot) && compare(pivot, *first)) {
-                std::swap(*first, *(f + left_pivot_size++));
-            }
-            ++first;
-        }
-        if (first < last) {
-            std::swap(*first, *(last--));
-        }
-    }
-    *first = pivot;
-    --first;
-    ++last;
-    for (int i = 0; i < left_pivot_size; ++i) {
-        std::swap(*(first--), *(f + i));
-    }
-    for (int i = 0; i < right_pivot_size; ++i) {
-        std::swap(*(last++), *(l - i - 1));
-    }
-    quick_sort(f, first + 1, compare);
-    quick_sort(last, l, compare);
-}
-
-
-template <typename Iterator, typename Compare = std::less_equal<typename std::iterator_traits<Iterator>::value_type>>
-void merge_sort(Iterator first, Iterator last, Compare compare = Compare{}) {
-    static_assert(std::is_same<typename std::iterator_traits<Iterator>::iterator_category, std::random_access_iterator_tag>::value, "only allow random iterator");
-    if (last - first <= 1) {
-        return;
-    }
-    auto middle = first + (last - first) / 2;
-    merge_sort(first, middle, compare);
-    merge_sort(middle, last, compare);
-
-    using value_type = typename std::iterator_traits<Iterator>::value_type;
-    vector<value_type> result(last - first, value_type{});
-
-    auto left = first;
-    auto right = middle;
-    int index = 0;
-    while (left < middle && right < last) {
-        if (compare(*left, *right)) {
-            result[index++] = *(left++);
-        }
-        else {
-            result[index++] = *(right++);
-        }
-    }
-    while (left < middle) {
-        result[index++] = *(left++);
-    }
-    while (right < last) {
-        result[index++] = *(right++);
-    }
-    std::copy(result.begin(), result.end(), first);
-    // assert(std::is_sorted(first, last, compare));
-}
-
-
-template <typename Iterator, typename Compare = std::less_equal<typename std::iterator_traits<Iterator>::value_type>>
-void select_sort(Iterator first, Iterator last, Compare compare = Compare{}) {
-    static_assert(std::is_same<typename std::iterator_traits<Iterator>::iterator_category, std::random_access_iterator_tag>::value, "only allow random iterator");
-    auto right = last - 1;
-    while (right > first) {
-        auto max_iter = first;
-        auto cur = first + 1;
-        while (cur <= right) {
-            if (compare(*max_iter, *cur)) {
-                max_iter = cur;
-            }
-            ++cur;
-        }
-        std::swap(*max_iter, *right);
-        --right;
-    }
-}
-
-template <typename Iterator, typename Compare = std::less_equal<typename std::iterator_traits<Iterator>::value_type>>
-void bubble_sort(Iterator first, Iterator last, Compare compare = Compare{}) {
-    static_assert(std::is_same<typename std::iterator_traits<Iterator>::iterator_category, std::random_access_iterator_tag>::value, "only allow random iterator");
-    auto right = last - 1;
-    while (right > first) {
-        auto max_iter = first;
-        auto cur = first + 1;
-        while (cur <= right) {
-            if (compare(*cur, *(cur - 1))) {
-                std::swap(*cur, *(cur - 1));
-            }
-            ++cur;
-        }
-        --right;
-    }
-}
-
-void bubble_sort(vector<int>& nums) {
-    for (int i = 0; i < nums.size() - 1; ++i) {
-        for (int j = 1; j < nums.size() - i; ++j) {
-            if (nums[j] < nums[j - 1]) {
-                std::swap(nums[j], nums[j - 1]);
-            }
-        }
-    }
-}
-
-void select_sort(vector<int>& nums) {
-    for (int i = 0; i < nums.size() - 1; ++i) {
-        auto max_iter = std::max_element(nums.begin(), nums.end() - i);
-        std::swap(*max_iter, *(nums.end() - i - 1));
-    }
-}
-
-void insert_sort(vector<int>& nums) {
-    int cur = 0;
-    for (int i = 1; i < nums.size(); ++i) {
-        int value = nums[i];
-        int cur = i;
-        int prev = i - 1;
-        while (cur > 0 && nums[prev] > value) {
-            nums[cur] = nums[prev];
-            --cur;
-            --prev;
-        }
-        nums[cur] = value;
-    }
-}
-
-void shell_sort(vector<int>& nums) {
-    size_t len = nums.size();
-    for (int gap = std::floor(len / 2); gap > 0; gap = std::floor(gap / 2)) {
-        for (int i = gap; i < len; ++i) {
-            auto value = nums[i];
-            int index = i;
-            while (index - gap >= 0 && nums[index - gap] > value) {
-                nums[index] = nums[index - gap];
-                index -= gap;
-            }
-            nums[index] = value;
-        }
-    }
-}
-
-void make_heap(vector<int>& nums) {
-    int len = nums.size();
-    int current = len;
-    for (int i = len; i > 0; --i) {
-        int value = nums[i - 1];
-        int current = i;
-        int child = current * 2;
-        while (child <= len) {
-            if (child < len && nums[child - 1] > nums[child]) {
-                ++child;
-            }
-            if (nums[child - 1] >= value) {
-                break;
-            }
-            nums[current - 1] = nums[child - 1];
-            current = child;
-            child = current * 2;
-        }
-        nums[current - 1] = value;
-    }
-}
-
-void pop_heap(vector<int>& nums) {
-    int len = nums.size();
-    std::swap(nums[0], nums[len - 1]);
-    int current = 1;
-    int child = current * 2;
-    int value = nums[current - 1];
-    while (child <= len - 1) {
-        if (child < len - 1 && nums[child - 1] > nums[child]) {
-            ++child;
-        }
-        if (nums[child - 1] > value) {
-            break;
-        }
-        nums[current - 1] = nums[child - 1];
-        current = child;
-        child = current * 2;
-    }
-    nums[current - 1] = value;
-}
-
-void push_heap(vector<int>& nums) {
-    int len = nums.size();
-    int current = len;
-    int parent = current / 2;
-    int value = nums[current - 1];
-    while (parent > 0) {
-        if (value >= nums[parent - 1]) {
-            break;
-        }
-        nums[current - 1] = nums[parent - 1];
-        current = parent;
-        parent = current / 2;
-    }
-    nums[current - 1] = value;
-}
-void heap_sort(vector<int>& nums) {
-    make_heap(nums);
-    vector<int> results;
-    while (!nums.empty()) {
-        pop_heap(nums);
-        results.emplace_back(nums.back());
-        nums.pop_back();
-    }
-    nums.swap(results);
-}
-
-template <typename Iterator, typename Compare = std::less_equal<typename std::iterator_traits<Iterator>::value_type>>
-void list_quick_sort(Iterator first, Iterator last, Compare compare = Compare{}) {
-    static_assert(std::is_same<typename std::iterator_traits<Iterator>::iterator_category, std::bidirectional_iterator_tag>::value, "only allow bidirectional iterator");
-    if (first == last) {
-        return;
-    }
-    Iterator p = first;
-    Iterator q = first;
-    ++q;
-    while (q != last) {
-        if (compare(*q, *first)) {
-            ++p;
-            std::swap(*p, *q);
-        }
-        ++q;
-    }
-    std::swap(*p, *first);
-    list_quick_sort(first, p);
-    list_quick_sort(++p, last);
-}
-
-
-void make_heap(vector<int>& nums) {
-    int len = nums.size();
-    for (int i = len; i > 0; --i) {
-        int current = i;
-        int child = current * 2;
-        int value = nums[current - 1];
-        while (child <= len) {
-            if (child < len && nums[child - 1] > nums[child]) {
-                ++child;
-            }
-            if (nums[child - 1] >= value) {
-                break;
-            }
-            nums[current - 1] = nums[child - 1];
-            current = child;
-            child = current * 2;
-        }
-        nums[current - 1] = value;
-    }
-}
-void push_heap(vector<int>& nums) {
-    int len = nums.size();
-    int current = len;
-    int parent = current / 2;
-    int value = nums[current - 1];
-    while (current > 1) {
-        if (nums[parent - 1] <= value) {
-            break;
-        }
-        nums[current - 1] = nums[parent - 1];
-        current = parent;
-        parent = current / 2;
-    }
-    nums[current - 1] = value;
-}
-
-void pop_heap(vector<int>& nums) {
-    int len = nums.size();
-    std::swap(nums[0], nums[len - 1]);
-    int current = 1;
-    int child = current * 2;
-    int value = nums[current - 1];
-    while (child <= len) {
-        if (child < len && nums[child - 1] > nums[child]) {
-            ++child;
-        }
-        nums[current - 1] = nums[child - 1];
-        current = child;
-        child = current * 2;
-    }
-    nums[current - 1] = value;
-}
-
-template <typename Iterator, typename Compare = std::less_equal<typename std::iterator_traits<Iterator>::value_type>>
-void link_quick_sort(Iterator first, Iterator last, Compare compare = Compare{}) {
-    if (first == last) {
-        return;
-    }
-    Iterator p = first;
-    Iterator q = first;
-    ++q;
-    while (q != last) {
-        if (compare(*q, *first)) {
-            ++p;
-            std::swap(*p, *q);
-        }
-        ++q;
-    }
-    std::swap(*first, *p);
-    link_quick_sort(first, p, compare);
-    link_quick_sort(++p, last, compare);
-}
-
-
-template <typename Iterator, typename Compare = std::less_equal<std::iterator_traits<Iterator>::value_type>>
-void insert_sort(Iterator first, Iterator last, Compare compare = Compare{}) {
-    if (first == last) {
-        return;
-    }
-    Iterator current = first;
-    for (auto it = first; it != last; ++it) {
-        current = it;
-        int value = *current;
-        while (current != first && compare(value, *(current - 1))) {
-            *current = *(current - 1);
-            --current;
-        }
-        *current = value;
-    }
-}
-
-template <typename Iterator, typename Compare = std::less_equal<std::iterator_traits<Iterator>::value_type>>
-void enable_median(Iterator first, Iterator last, Compare compare = Compare{}) {
-    if (first == last) {
-        return;
-    }
-    Iterator middle = first + (last - first) / 2;
-    if (compare(*middle, *first)) {
-        std::swap(*middle, *first);
-    }
-    if (compare(*last, *first)) {
-        std::swap(*last, *first);
-    }
-    if (compare(*last, *middle)) {
-        std::swap(*last, *middle);
-    }
-    std::swap(*first, *middle);
-}
-
-template <typename Iterator, typename Compare = std::less_equal<std::iterator_traits<Iterator>::value_type>>
-void quick_sort(Iterator first, Iterator last, Compare compare = Compare{}) {
-    if (first == last) {
-        return;
-    }
-    if (std::distance(first, last) <= 10) {
-        insert_sort(first, last, compare);
-        return;
-    }
-    enable_median(first, last, compare);
-    using value_type = std::iterator_traits<Iterator>::value_type;
-    value_type pivot = *first;
-    Iterator left = first;
-    Iterator right = last;
-    --right;
-    size_t left_pivot_size = 0;
-    size_t right_pivot_size = 0;
-    while (left < last) {
-        while (left < right && (compare(pivot, *right) || pivot == *right)) {
-            if (pivot == *right) {
-                std::swap(*right, *(last - right_pivot_size++ - 1));
-            }
-            --right;
-        }
-        if (left < right) {
-            std::swap(*(left++), *right);
-        }
-        while (left < right && (compare(*left, pivot) || *left == pivot)) {
-            if (*left == pivot) {
-                std::swap(*left, *(first + left_pivot_size++));
-            }
-            ++left;
-        }
-        if (left < right) {
-            std::swap(*left, *(right--));
-        }
-    }
-    *left = pivot;
-    for (size_t i = 0; i < left_pivot_size; ++i) {
-        std::swap(*(left - i - 1), *(first + i));
-    }
-    for (size_t i = 0; i < right_pivot_size; ++i) {
-        std::swap(*(right + i + 1), *(last - i - 1));
-    }
-    quick_sort(first, left - left_pivot_size, compare);
-    quick_sort(right + right_pivot_size + 1, last, compare);
-}
-
-}
\ No newline at end of file
+#pragma once
+
+#include <cmath>
+#include <algorithm>
+#include <iterator>
+#include <vector>
+#include <type_traits>
+#include <functional>
+#include <utility>
+#include <tuple>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <atomic>
+#include <thread>
+#include "heap.hpp"
+#include "simd_sort.hpp"
+#include "thread_pool.hpp"
+namespace tinystl {
+
+using std::vector;
+
+template <typename Iterator, typename Compare = std::less_equal<typename std::iterator_traits<Iterator>::value_type>>
+void insert_sort(Iterator first, Iterator last, Compare compare = Compare{}) {
+    static_assert(std::is_same<typename std::iterator_traits<Iterator>::iterator_category, std::random_access_iterator_tag>::value, "only allow random iterator");
+    auto cur = first;
+    while (cur != last) {
+        auto value = *cur;
+        auto next = cur + 1;
+        auto prev = cur - 1;
+        while (cur > first && compare(value, *prev)) {
+            *cur = *prev;
+            --cur;
+            --prev;
+        }
+        *cur = value;
+        cur = next;
+    }
+}
+
+template <typename Iterator, typename Compare = std::less_equal<typename std::iterator_traits<Iterator>::value_type>>
+void enable_midian(Iterator first, Iterator last, Compare compare) {
+    static_assert(std::is_same<typename std::iterator_traits<Iterator>::iterator_category, std::random_access_iterator_tag>::value, "only allow random iterator");
+    auto middle = first + (last - first) / 2;
+    --last;
+    if (compare(*middle, *first)) {
+        std::swap(*middle, *first);
+    }
+    if (compare(*last, *first)) {
+        std::swap(*last, *first);
+    }
+    if (compare(*last, *middle)) {
+        std::swap(*middle, *last);
+    }
+    std::swap(*first, *middle);
+}
+
+namespace detail {
+
+// standard orderings on arithmetic keys get the branchless block partition, less() is the strict form of the order
+template <typename Compare>
+struct block_order : std::false_type {};
+
+template <typename T>
+struct block_order<std::less<T>> : std::true_type {
+    template <typename U>
+    static bool less(const U& a, const U& b) { return a < b; }
+};
+
+template <typename T>
+struct block_order<std::less_equal<T>> : block_order<std::less<T>> {};
+
+template <typename T>
+struct block_order<std::greater<T>> : std::true_type {
+    template <typename U>
+    static bool less(const U& a, const U& b) { return a > b; }
+};
+
+template <typename T>
+struct block_order<std::greater_equal<T>> : block_order<std::greater<T>> {};
+
+// the sorting networks only sort ascending and need the elements in contiguous memory
+template <typename Iterator, typename Compare>
+struct use_network_sort {
+    using value_type = typename std::iterator_traits<Iterator>::value_type;
+    static constexpr bool value = simd::is_network_type<value_type>::value &&
+        (std::is_same<Iterator, value_type*>::value || std::is_same<Iterator, typename vector<value_type>::iterator>::value) &&
+        (std::is_same<Compare, std::less<value_type>>::value || std::is_same<Compare, std::less_equal<value_type>>::value);
+};
+
+// leaf sort for small ranges, returns false when no sorting network applies
+template <typename Iterator, typename Compare>
+bool network_sort(Iterator first, Iterator last, const Compare&) {
+    if constexpr (use_network_sort<Iterator, Compare>::value) {
+        return simd::sort_small(&*first, last - first);
+    }
+    else {
+        return false;
+    }
+}
+
+template <typename Iterator, typename Compare>
+using use_block_partition = std::integral_constant<bool,
+    std::is_arithmetic<typename std::iterator_traits<Iterator>::value_type>::value && block_order<Compare>::value>;
+
+// BlockQuicksort: gather the offsets of misplaced elements of a left and a right block without branching
+// on the comparison result, then swap them pairwise; the short remainder goes through std::partition
+template <typename Iterator, typename Predicate>
+Iterator block_partition(Iterator first, Iterator last, Predicate pred) {
+    constexpr int block = 64;
+    unsigned char offsets_left[block];
+    unsigned char offsets_right[block];
+    int num_left = 0;
+    int num_right = 0;
+    int start_left = 0;
+    int start_right = 0;
+    while (last - first > 2 * block) {
+        if (num_left == 0) {
+            start_left = 0;
+            for (int i = 0; i < block; ++i) {
+                offsets_left[num_left] = static_cast<unsigned char>(i);
+                num_left += !pred(*(first + i));
+            }
+        }
+        if (num_right == 0) {
+            start_right = 0;
+            for (int i = 0; i < block; ++i) {
+                offsets_right[num_right] = static_cast<unsigned char>(i);
+                num_right += pred(*(last - 1 - i));
+            }
+        }
+        int num = std::min(num_left, num_right);
+        for (int i = 0; i < num; ++i) {
+            std::iter_swap(first + offsets_left[start_left + i], last - 1 - offsets_right[start_right + i]);
+        }
+        num_left -= num;
+        num_right -= num;
+        start_left += num;
+        start_right += num;
+        if (num_left == 0) {
+            first += block;
+        }
+        if (num_right == 0) {
+            last -= block;
+        }
+    }
+    return std::partition(first, last, pred);
+}
+
+template <typename Iterator, typename Compare>
+std::pair<Iterator, Iterator> pivot_partition_impl(Iterator first, Iterator last, Compare, std::true_type) {
+    using order = block_order<Compare>;
+    const auto pivot = *first;
+    auto middle = block_partition(first + 1, last, [pivot](const decltype(pivot)& value) { return order::less(value, pivot); });
+    std::iter_swap(first, middle - 1);
+    auto equal_first = middle - 1;
+    // two-way split keeps keys equal to the pivot on the right, peel them off when they dominate the range
+    if ((last - middle) * 8 > (last - first) * 7) {
+        middle = block_partition(middle, last, [pivot](const decltype(pivot)& value) { return !order::less(pivot, value); });
+    }
+    return std::make_pair(equal_first, middle);
+}
+
+template <typename Iterator, typename Compare>
+std::pair<Iterator, Iterator> pivot_partition_impl(Iterator first, Iterator last, Compare compare, std::false_type) {
+    auto pivot = *first;
+    auto f = first;
+    auto l = last;
+    --last;
+
+    int left_pivot_size = 0;
+    int right_pivot_size = 0;
+    while (first < last) {
+        while (first < last && (!compare(*last, pivot) || (compare(*last, pivot) && compare(pivot, *last)))) {
+            if (compare(*last, pivot) && compare(pivot, *last)) {
+                std::swap(*last, *(l - right_pivot_size++ - 1));
+            }
+            --last;
+        }
+        if (first < last) {
+            std::swap(*(first++), *last);
+        }
+        while (first < last && compare(*first, pivot)) {
+            if (compare(*first, pivot) && compare(pivot, *first)) {
+                std::swap(*first, *(f + left_pivot_size++));
+            }
+            ++first;
+        }
+        if (first < last) {
+            std::swap(*first, *(last--));
+        }
+    }
+    *first = pivot;
+    --first;
+    ++last;
+    for (int i = 0; i < left_pivot_size; ++i) {
+        std::swap(*(first--), *(f + i));
+    }
+    for (int i = 0; i < right_pivot_size; ++i) {
+        std::swap(*(last++), *(l - i - 1));
+    }
+    return std::make_pair(first + 1, last);
+}
+
+}
+
+// three-way partition around *first, returns the range of elements equal to the pivot
+template <typename Iterator, typename Compare>
+std::pair<Iterator, Iterator> pivot_partition(Iterator first, Iterator last, Compare compare) {
+    static_assert(std::is_same<typename std::iterator_traits<Iterator>::iterator_category, std::random_access_iterator_tag>::value, "only allow random iterator");
+    return detail::pivot_partition_impl(first, last, compare, detail::use_block_partition<Iterator, Compare>{});
+}
+
+template <typename Iterator, typename Compare>
+std::pair<Iterator, Iterator> quick_partition(Iterator first, Iterator last, Compare compare) {
+    enable_midian(first, last, compare);
+    return pivot_partition(first, last, compare);
+}
+
+template <typename Iterator, typename Compare = std::less_equal<typename std::iterator_traits<Iterator>::value_type>>
+void quick_sort(Iterator first, Iterator last, Compare compare = Compare{}) {
+    static_assert(std::is_same<typename std::iterator_traits<Iterator>::iterator_category, std::random_access_iterator_tag>::value, "only allow random iterator");
+    if (first == last || first + 1 == last) {
+        return;
+    }
+    if (last - first <= static_cast<std::ptrdiff_t>(simd::max_network_size) && detail::network_sort(first, last, compare)) {
+        return;
+    }
+    if (last - first <= 10) {
+        insert_sort(first, last, compare);
+        return;
+    }
+    auto bounds = quick_partition(first, last, compare);
+    quick_sort(first, bounds.first, compare);
+    quick_sort(bounds.second, last, compare);
+}
+
+namespace detail {
+
+template <typename Iterator, typename Compare>
+void sort3(Iterator a, Iterator b, Iterator c, Compare& compare) {
+    if (compare(*b, *a)) {
+        std::swap(*a, *b);
+    }
+    if (compare(*c, *b)) {
+        std::swap(*b, *c);
+    }
+    if (compare(*b, *a)) {
+        std::swap(*a, *b);
+    }
+}
+
+// median-of-three for short ranges, Tukey's ninther for long ones, the pivot ends up at *first
+template <typename Iterator, typename Compare>
+void choose_pivot(Iterator first, Iterator last, Compare& compare) {
+    auto len = last - first;
+    auto middle = first + len / 2;
+    if (len > 128) {
+        sort3(first, middle, last - 1, compare);
+        sort3(first + 1, middle - 1, last - 2, compare);
+        sort3(first + 2, middle + 1, last - 3, compare);
+        sort3(middle - 1, middle, middle + 1, compare);
+    }
+    else {
+        sort3(first, middle, last - 1, compare);
+    }
+    std::swap(*first, *middle);
+}
+
+// "strictly less" for both comparator flavours in this header: compare(x, x) tells a non-strict
+// comparator (less_equal) from a strict one, so every query still costs a single call
+template <typename Compare>
+struct strict_order {
+    template <typename T>
+    strict_order(Compare& c, const T& sample) : compare(c), non_strict(c(sample, sample)) {}
+
+    template <typename T>
+    bool operator()(const T& a, const T& b) const { return non_strict ? !compare(b, a) : compare(a, b); }
+
+    Compare& compare;
+    bool non_strict;
+};
+
+// sorts [first, last) in one pass when it is already ascending or descending
+template <typename Iterator, typename Compare>
+bool sorted_run(Iterator first, Iterator last, Compare& compare) {
+    strict_order<Compare> less(compare, *first);
+    bool ascending = true;
+    bool descending = true;
+    for (auto cur = first + 1; cur != last && (ascending || descending); ++cur) {
+        if (less(*cur, *(cur - 1))) {
+            ascending = false;
+        }
+        else if (less(*(cur - 1), *cur)) {
+            descending = false;
+        }
+    }
+    if (descending && !ascending) {
+        std::reverse(first, last);
+    }
+    return ascending || descending;
+}
+
+template <typename Iterator, typename Compare>
+void intro_sort_loop(Iterator first, Iterator last, Compare& compare, int bad_allowed) {
+    while (last - first > 16) {
+        if (sorted_run(first, last, compare)) {
+            return;
+        }
+        if (bad_allowed == 0) {
+            tinystl::heap_sort(first, last, compare);
+            return;
+        }
+        auto len = last - first;
+        choose_pivot(first, last, compare);
+        auto bounds = pivot_partition(first, last, compare);
+        auto left_len = bounds.first - first;
+        auto right_len = last - bounds.second;
+        // a lopsided split means the pivot choice is being defeated: shuffle a few elements to break the pattern
+        if (left_len < len / 8 || right_len < len / 8) {
+            --bad_allowed;
+            if (left_len > 16) {
+                std::swap(*first, *(first + left_len / 4));
+                std::swap(*(bounds.first - 1), *(bounds.first - left_len / 4));
+            }
+            if (right_len > 16) {
+                std::swap(*bounds.second, *(bounds.second + right_len / 4));
+                std::swap(*(last - 1), *(last - right_len / 4));
+            }
+        }
+        // recurse into the smaller side and loop on the larger one to keep the stack at O(log n)
+        if (left_len < right_len) {
+            intro_sort_loop(first, bounds.first, compare, bad_allowed);
+            first = bounds.second;
+        }
+        else {
+            intro_sort_loop(bounds.second, last, compare, bad_allowed);
+            last = bounds.first;
+        }
+    }
+    insert_sort(first, last, compare);
+}
+
+}
+
+// introspective quick_sort: ninther pivots, linear time on sorted or reversed runs, and a heap sort
+// fallback once too many unbalanced partitions were seen, so the worst case stays O(n log n)
+template <typename Iterator, typename Compare = std::less_equal<typename std::iterator_traits<Iterator>::value_type>>
+void intro_sort(Iterator first, Iterator last, Compare compare = Compare{}) {
+    static_assert(std::is_same<typename std::iterator_traits<Iterator>::iterator_category, std::random_access_iterator_tag>::value, "only allow random iterator");
+    if (last - first <= 1) {
+        return;
+    }
+    int bad_allowed = 0;
+    for (auto len = last - first; len > 1; len >>= 1) {
+        ++bad_allowed;
+    }
+    detail::intro_sort_loop(first, last, compare, bad_allowed);
+}
+
+namespace detail {
+
+template <typename Executor>
+void help_until_done(Executor& executor, const std::atomic<std::size_t>& pending) {
+    while (pending.load(std::memory_order_acquire) != 0) {
+        if (!executor.try_run_one()) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+// blocked parallel partition: every block is partitioned on its own, then the elements that ended up
+// on the wrong side of the global split point are swapped pairwise, again split across the executor
+template <typename Iterator, typename Predicate, typename Executor>
+Iterator parallel_partition(Iterator first, Iterator last, Predicate pred, Executor& executor, std::size_t blocks) {
+    using difference_type = typename std::iterator_traits<Iterator>::difference_type;
+    using span = std::pair<Iterator, Iterator>;
+    difference_type block_size = (last - first + blocks - 1) / blocks;
+    vector<span> chunks;
+    for (auto lo = first; lo < last; lo += std::min(block_size, last - lo)) {
+        chunks.emplace_back(lo, lo + std::min(block_size, last - lo));
+    }
+    vector<Iterator> middles(chunks.size());
+    std::atomic<std::size_t> pending(chunks.size());
+    for (std::size_t i = 0; i < chunks.size(); ++i) {
+        executor.submit([&, i] {
+            middles[i] = std::partition(chunks[i].first, chunks[i].second, pred);
+            pending.fetch_sub(1, std::memory_order_release);
+        });
+    }
+    help_until_done(executor, pending);
+
+    auto split = first;
+    for (std::size_t i = 0; i < chunks.size(); ++i) {
+        split += middles[i] - chunks[i].first;
+    }
+    vector<span> left_wrong;
+    vector<span> right_wrong;
+    for (std::size_t i = 0; i < chunks.size(); ++i) {
+        if (middles[i] < std::min(chunks[i].second, split)) {
+            left_wrong.emplace_back(middles[i], std::min(chunks[i].second, split));
+        }
+        if (std::max(chunks[i].first, split) < middles[i]) {
+            right_wrong.emplace_back(std::max(chunks[i].first, split), middles[i]);
+        }
+    }
+    auto prefix = [](const vector<span>& spans) {
+        vector<difference_type> sums(1, 0);
+        for (auto& s : spans) {
+            sums.push_back(sums.back() + (s.second - s.first));
+        }
+        return sums;
+    };
+    auto left_prefix = prefix(left_wrong);
+    auto right_prefix = prefix(right_wrong);
+    difference_type wrong = left_prefix.back();
+    if (wrong == 0) {
+        return split;
+    }
+    auto locate = [](const vector<span>& spans, const vector<difference_type>& sums, difference_type k) {
+        std::size_t index = std::upper_bound(sums.begin(), sums.end(), k) - sums.begin() - 1;
+        return std::make_pair(index, spans[index].first + (k - sums[index]));
+    };
+    difference_type step = (wrong + blocks - 1) / blocks;
+    for (difference_type k = 0; k < wrong; k += step) {
+        pending.fetch_add(1, std::memory_order_relaxed);
+        executor.submit([&, k] {
+            auto l = locate(left_wrong, left_prefix, k);
+            auto r = locate(right_wrong, right_prefix, k);
+            for (auto count = std::min(step, wrong - k); count > 0; --count) {
+                if (l.second == left_wrong[l.first].second) {
+                    l.second = left_wrong[++l.first].first;
+                }
+                if (r.second == right_wrong[r.first].second) {
+                    r.second = right_wrong[++r.first].first;
+                }
+                std::swap(*(l.second++), *(r.second++));
+            }
+            pending.fetch_sub(1, std::memory_order_release);
+        });
+    }
+    help_until_done(executor, pending);
+    return split;
+}
+
+// same contract as quick_partition, the equal range is only split off when it would otherwise stall progress
+template <typename Iterator, typename Compare, typename Executor>
+std::pair<Iterator, Iterator> parallel_quick_partition(Iterator first, Iterator last, Compare compare, Executor& executor, std::size_t blocks) {
+    using value_type = typename std::iterator_traits<Iterator>::value_type;
+    enable_midian(first, last, compare);
+    const value_type pivot = *first;
+    auto len = last - first;
+    auto middle = parallel_partition(first, last, [&](const value_type& value) { return compare(value, pivot); }, executor, blocks);
+    auto not_greater = [&](const value_type& value) { return !compare(pivot, value); };
+    // compare(pivot, pivot) tells whether the comparator is non-strict (less_equal) and keeps equal keys on the left
+    if (compare(pivot, pivot)) {
+        if ((middle - first) * 8 > len * 7) {
+            return std::make_pair(parallel_partition(first, middle, not_greater, executor, blocks), middle);
+        }
+    }
+    else if ((last - middle) * 8 > len * 7) {
+        return std::make_pair(middle, parallel_partition(middle, last, not_greater, executor, blocks));
+    }
+    return std::make_pair(middle, middle);
+}
+
+template <typename Iterator, typename Compare, typename Executor>
+void parallel_quick_sort_task(Iterator first, Iterator last, Compare compare, Executor& executor,
+                              typename std::iterator_traits<Iterator>::difference_type cutoff,
+                              typename std::iterator_traits<Iterator>::difference_type partition_cutoff,
+                              std::atomic<std::size_t>& pending) {
+    while (last - first > cutoff) {
+        auto bounds = last - first > partition_cutoff ? parallel_quick_partition(first, last, compare, executor, executor.size() * 4)
+                                                      : quick_partition(first, last, compare);
+        auto left_last = bounds.first;
+        pending.fetch_add(1, std::memory_order_relaxed);
+        executor.submit([=, &executor, &pending] {
+            parallel_quick_sort_task(first, left_last, compare, executor, cutoff, partition_cutoff, pending);
+            pending.fetch_sub(1, std::memory_order_release);
+        });
+        first = bounds.second;
+    }
+    intro_sort(first, last, compare);
+}
+
+}
+
+// quick_sort whose subranges above the cutoff are handed to the executor, an executor needs
+// submit(func), try_run_one() and size(); ranges at the very top are also partitioned in parallel
+template <typename Iterator, typename Compare, typename Executor>
+void parallel_quick_sort(Iterator first, Iterator last, Compare compare, Executor& executor) {
+    static_assert(std::is_same<typename std::iterator_traits<Iterator>::iterator_category, std::random_access_iterator_tag>::value, "only allow random iterator");
+    using difference_type = typename std::iterator_traits<Iterator>::difference_type;
+    difference_type len = last - first;
+    difference_type threads = executor.size();
+    difference_type cutoff = std::max<difference_type>(1 << 14, len / (threads * 32));
+    if (threads <= 1 || len <= cutoff) {
+        intro_sort(first, last, compare);
+        return;
+    }
+    difference_type partition_cutoff = std::max(cutoff * 8, len / threads);
+    std::atomic<std::size_t> pending(1);
+    detail::parallel_quick_sort_task(first, last, compare, executor, cutoff, partition_cutoff, pending);
+    pending.fetch_sub(1, std::memory_order_release);
+    detail::help_until_done(executor, pending);
+}
+
+template <typename Iterator, typename Compare = std::less_equal<typename std::iterator_traits<Iterator>::value_type>>
+void parallel_quick_sort(Iterator first, Iterator last, Compare compare = Compare{}) {
+    parallel_quick_sort(first, last, compare, thread_pool::default_pool());
+}
+
+
+template <typename Iterator, typename Compare = std::less_equal<typename std::iterator_traits<Iterator>::value_type>>
+void merge_sort(Iterator first, Iterator last, Compare compare = Compare{}) {
+    static_assert(std::is_same<typename std::iterator_traits<Iterator>::iterator_category, std::random_access_iterator_tag>::value, "only allow random iterator");
+    if (last - first <= 1) {
+        return;
+    }
+    if (last - first <= static_cast<std::ptrdiff_t>(simd::max_network_size) && detail::network_sort(first, last, compare)) {
+        return;
+    }
+    auto middle = first + (last - first) / 2;
+    merge_sort(first, middle, compare);
+    merge_sort(middle, last, compare);
+
+    using value_type = typename std::iterator_traits<Iterator>::value_type;
+    vector<value_type> result(last - first, value_type{});
+
+    auto left = first;
+    auto right = middle;
+    int index = 0;
+    while (left < middle && right < last) {
+        if (compare(*left, *right)) {
+            result[index++] = *(left++);
+        }
+        else {
+            result[index++] = *(right++);
+        }
+    }
+    while (left < middle) {
+        result[index++] = *(left++);
+    }
+    while (right < last) {
+        result[index++] = *(right++);
+    }
+    std::copy(result.begin(), result.end(), first);
+    // assert(std::is_sorted(first, last, compare));
+}
+
+
+namespace detail {
+
+template <typename Less>
+struct flipped_order {
+    template <typename T>
+    bool operator()(const T& a, const T& b) const { return less(b, a); }
+
+    Less less;
+};
+
+// exponential search followed by a binary search, cheap when the answer is close to first
+template <typename Iterator, typename T, typename Less>
+Iterator gallop_upper(Iterator first, Iterator last, const T& key, Less& less) {
+    if (first == last || less(key, *first)) {
+        return first;
+    }
+    typename std::iterator_traits<Iterator>::difference_type len = last - first, lo = 0, step = 1;
+    while (lo + step < len && !less(key, *(first + lo + step))) {
+        lo += step;
+        step *= 2;
+    }
+    return std::upper_bound(first + lo + 1, first + std::min(lo + step, len), key, less);
+}
+
+template <typename Iterator, typename T, typename Less>
+Iterator gallop_lower(Iterator first, Iterator last, const T& key, Less& less) {
+    if (first == last || !less(*first, key)) {
+        return first;
+    }
+    typename std::iterator_traits<Iterator>::difference_type len = last - first, lo = 0, step = 1;
+    while (lo + step < len && less(*(first + lo + step), key)) {
+        lo += step;
+        step *= 2;
+    }
+    return std::lower_bound(first + lo + 1, first + std::min(lo + step, len), key, less);
+}
+
+// stable merge of a run parked in the buffer with the run that follows it in place, into dest; once one side
+// wins seven times in a row it switches to galloping and moves whole blocks
+template <typename BufferIterator, typename Iterator, typename Less>
+void merge_from_buffer(BufferIterator buffer_first, BufferIterator buffer_last, Iterator second, Iterator second_last, Iterator dest, Less less) {
+    constexpr int min_gallop = 7;
+    while (buffer_first != buffer_last && second != second_last) {
+        int buffer_wins = 0;
+        int second_wins = 0;
+        while (buffer_first != buffer_last && second != second_last && buffer_wins < min_gallop && second_wins < min_gallop) {
+            if (less(*second, *buffer_first)) {
+                *(dest++) = std::move(*(second++));
+                ++second_wins;
+                buffer_wins = 0;
+            }
+            else {
+                *(dest++) = std::move(*(buffer_first++));
+                ++buffer_wins;
+                second_wins = 0;
+            }
+        }
+        while (buffer_first != buffer_last && second != second_last && (buffer_wins >= min_gallop || second_wins >= min_gallop)) {
+            auto buffer_next = gallop_upper(buffer_first, buffer_last, *second, less);
+            buffer_wins = static_cast<int>(std::min<std::ptrdiff_t>(buffer_next - buffer_first, min_gallop));
+            dest = std::move(buffer_first, buffer_next, dest);
+            buffer_first = buffer_next;
+            if (buffer_first == buffer_last) {
+                break;
+            }
+            *(dest++) = std::move(*(second++));
+            auto second_next = gallop_lower(second, second_last, *buffer_first, less);
+            second_wins = static_cast<int>(std::min<std::ptrdiff_t>(second_next - second, min_gallop));
+            dest = std::move(second, second_next, dest);
+            second = second_next;
+            if (second == second_last) {
+                break;
+            }
+            *(dest++) = std::move(*(buffer_first++));
+        }
+    }
+    std::move(buffer_first, buffer_last, dest);
+}
+
+// merges the adjacent sorted runs [first, middle) and [middle, last), only the shorter one is moved into the buffer
+template <typename Iterator, typename BufferIterator, typename Less>
+void merge_runs(Iterator first, Iterator middle, Iterator last, BufferIterator buffer, Less& less) {
+    first = gallop_upper(first, middle, *middle, less);
+    last = gallop_lower(middle, last, *(middle - 1), less);
+    if (first == middle || middle == last) {
+        return;
+    }
+    if (middle - first <= last - middle) {
+        auto buffer_last = std::move(first, middle, buffer);
+        merge_from_buffer(buffer, buffer_last, middle, last, first, less);
+    }
+    else {
+        // merging from the back is the same merge on reversed ranges with the order flipped
+        using reverse = std::reverse_iterator<Iterator>;
+        using reverse_buffer = std::reverse_iterator<BufferIterator>;
+        auto buffer_last = std::move(middle, last, buffer);
+        merge_from_buffer(reverse_buffer(buffer_last), reverse_buffer(buffer), reverse(middle), reverse(first), reverse(last),
+                          flipped_order<Less>{ less });
+    }
+}
+
+// length of the natural run at first, a strictly descending run is reversed in place so it stays stable
+template <typename Iterator, typename Less>
+typename std::iterator_traits<Iterator>::difference_type count_run(Iterator first, Iterator last, Less& less) {
+    auto cur = first + 1;
+    if (cur == last) {
+        return 1;
+    }
+    if (less(*cur, *first)) {
+        while (++cur != last && less(*cur, *(cur - 1))) {
+        }
+        std::reverse(first, cur);
+    }
+    else {
+        while (++cur != last && !less(*cur, *(cur - 1))) {
+        }
+    }
+    return cur - first;
+}
+
+template <typename Iterator, typename Less>
+void binary_insert_sort(Iterator first, Iterator sorted_last, Iterator last, Less& less) {
+    for (auto cur = sorted_last; cur != last; ++cur) {
+        auto pos = std::upper_bound(first, cur, *cur, less);
+        auto value = std::move(*cur);
+        std::move_backward(pos, cur, cur + 1);
+        *pos = std::move(value);
+    }
+}
+
+// TimSort run length: between 32 and 64 so that n / min_run is a power of two or just below one
+template <typename Size>
+Size min_run_length(Size n) {
+    Size low_bits = 0;
+    while (n >= 64) {
+        low_bits |= n & 1;
+        n >>= 1;
+    }
+    return n + low_bits;
+}
+
+template <typename Iterator, typename BufferIterator, typename Compare>
+void natural_merge_sort_impl(Iterator first, Iterator last, BufferIterator buffer, Compare& compare) {
+    using difference_type = typename std::iterator_traits<Iterator>::difference_type;
+    strict_order<Compare> less(compare, *first);
+    difference_type min_run = min_run_length(last - first);
+
+    // pending runs obey len[i - 2] > len[i - 1] + len[i] and len[i - 1] > len[i], which bounds the stack by log_phi(n)
+    struct run {
+        Iterator first;
+        difference_type len;
+    };
+    std::array<run, 96> runs;
+    std::size_t size = 0;
+    auto merge_at = [&](std::size_t i) {
+        merge_runs(runs[i].first, runs[i + 1].first, runs[i + 1].first + runs[i + 1].len, buffer, less);
+        runs[i].len += runs[i + 1].len;
+        for (std::size_t k = i + 1; k + 1 < size; ++k) {
+            runs[k] = runs[k + 1];
+        }
+        --size;
+    };
+
+    for (auto cur = first; cur != last;) {
+        difference_type len = count_run(cur, last, less);
+        if (len < min_run) {
+            difference_type extended = std::min(min_run, last - cur);
+            binary_insert_sort(cur, cur + len, cur + extended, less);
+            len = extended;
+        }
+        runs[size++] = run{ cur, len };
+        cur += len;
+        while (size > 1) {
+            std::size_t n = size - 2;
+            if ((n > 0 && runs[n - 1].len <= runs[n].len + runs[n + 1].len) || (n > 1 && runs[n - 2].len <= runs[n - 1].len + runs[n].len)) {
+                if (runs[n - 1].len < runs[n + 1].len) {
+                    --n;
+                }
+                merge_at(n);
+            }
+            else if (runs[n].len <= runs[n + 1].len) {
+                merge_at(n);
+            }
+            else {
+                break;
+            }
+        }
+    }
+    while (size > 1) {
+        std::size_t n = size - 2;
+        if (n > 0 && runs[n - 1].len < runs[n + 1].len) {
+            --n;
+        }
+        merge_at(n);
+    }
+}
+
+}
+
+// stable, move-only merge sort: natural runs are detected (descending ones reversed), short ones are extended with
+// binary insertion, and runs are merged bottom-up with galloping through one scratch buffer; buffer must have
+// room for (last - first) / 2 assignable elements so repeated sorts can reuse it
+template <typename Iterator, typename BufferIterator, typename Compare>
+void natural_merge_sort(Iterator first, Iterator last, BufferIterator buffer, Compare compare) {
+    static_assert(std::is_same<typename std::iterator_traits<Iterator>::iterator_category, std::random_access_iterator_tag>::value, "only allow random iterator");
+    if (last - first <= 1) {
+        return;
+    }
+    detail::natural_merge_sort_impl(first, last, buffer, compare);
+}
+
+template <typename Iterator, typename Compare = std::less_equal<typename std::iterator_traits<Iterator>::value_type>>
+void natural_merge_sort(Iterator first, Iterator last, Compare compare = Compare{}) {
+    static_assert(std::is_same<typename std::iterator_traits<Iterator>::iterator_category, std::random_access_iterator_tag>::value, "only allow random iterator");
+    using value_type = typename std::iterator_traits<Iterator>::value_type;
+    if (last - first <= 1) {
+        return;
+    }
+    // an already sorted range does not need the buffer at all
+    detail::strict_order<Compare> less(compare, *first);
+    if (detail::count_run(first, last, less) == last - first) {
+        return;
+    }
+    vector<value_type> buffer((last - first) / 2);
+    detail::natural_merge_sort_impl(first, last, buffer.begin(), compare);
+}
+
+namespace detail {
+
+// co-ranking: how many of the first k merged elements come from a, with ties resolved in favour of a
+template <typename Iterator, typename Less>
+typename std::iterator_traits<Iterator>::difference_type co_rank(typename std::iterator_traits<Iterator>::difference_type k,
+                                                                 Iterator a, typename std::iterator_traits<Iterator>::difference_type a_len,
+                                                                 Iterator b, typename std::iterator_traits<Iterator>::difference_type b_len, Less& less) {
+    auto lo = std::max<decltype(k)>(0, k - b_len);
+    auto hi = std::min(k, a_len);
+    while (lo < hi) {
+        auto i = lo + (hi - lo) / 2;
+        if (!less(*(b + (k - i - 1)), *(a + i))) {
+            lo = i + 1;
+        }
+        else {
+            hi = i;
+        }
+    }
+    return lo;
+}
+
+// stable merge of [a, a + a_len) and [b, b + b_len) into dest, cut into pieces of equal output size that merge independently.
+// all split points are found before the first piece starts: a running piece moves elements out of the runs, and
+// co-ranking over moved-from elements would pick wrong splits
+template <typename Iterator, typename OutputIterator, typename Less, typename Executor>
+void parallel_merge(Iterator a, typename std::iterator_traits<Iterator>::difference_type a_len,
+                    Iterator b, typename std::iterator_traits<Iterator>::difference_type b_len,
+                    OutputIterator dest, Less& less, Executor& executor, std::size_t pieces, std::atomic<std::size_t>& pending) {
+    using difference_type = typename std::iterator_traits<Iterator>::difference_type;
+    difference_type total = a_len + b_len;
+    difference_type piece = (total + pieces - 1) / pieces;
+    vector<difference_type> splits;
+    for (difference_type k = 0; k < total; k += piece) {
+        splits.push_back(co_rank(k, a, a_len, b, b_len, less));
+    }
+    splits.push_back(a_len);
+    for (std::size_t index = 0; index + 1 < splits.size(); ++index) {
+        difference_type k = static_cast<difference_type>(index) * piece;
+        difference_type k_last = std::min(k + piece, total);
+        difference_type i = splits[index];
+        difference_type i_last = splits[index + 1];
+        pending.fetch_add(1, std::memory_order_relaxed);
+        executor.submit([=, &less, &pending] {
+            std::merge(std::make_move_iterator(a + i), std::make_move_iterator(a + i_last),
+                       std::make_move_iterator(b + (k - i)), std::make_move_iterator(b + (k_last - i_last)), dest + k, less);
+            pending.fetch_sub(1, std::memory_order_release);
+        });
+    }
+}
+
+}
+
+// stable parallel merge sort: chunks are sorted concurrently with natural_merge_sort, then every merge level
+// ping-pongs between the range and one scratch buffer with each merge split by co-ranking across the executor
+template <typename Iterator, typename Compare, typename Executor>
+void parallel_merge_sort(Iterator first, Iterator last, Compare compare, Executor& executor) {
+    static_assert(std::is_same<typename std::iterator_traits<Iterator>::iterator_category, std::random_access_iterator_tag>::value, "only allow random iterator");
+    using value_type = typename std::iterator_traits<Iterator>::value_type;
+    using difference_type = typename std::iterator_traits<Iterator>::difference_type;
+    difference_type len = last - first;
+    std::size_t threads = executor.size();
+    if (threads <= 1 || len <= (1 << 15)) {
+        natural_merge_sort(first, last, compare);
+        return;
+    }
+    std::size_t chunks = 1;
+    while (chunks < threads) {
+        chunks *= 2;
+    }
+    vector<value_type> buffer(len);
+    detail::strict_order<Compare> less(compare, *first);
+    auto bound = [&](std::size_t index) { return static_cast<difference_type>(len * index / chunks); };
+
+    std::atomic<std::size_t> pending(chunks);
+    for (std::size_t i = 0; i < chunks; ++i) {
+        executor.submit([&, i] {
+            natural_merge_sort(first + bound(i), first + bound(i + 1), buffer.begin() + bound(i), compare);
+            pending.fetch_sub(1, std::memory_order_release);
+        });
+    }
+    detail::help_until_done(executor, pending);
+
+    bool in_buffer = false;
+    for (std::size_t width = 1; width < chunks; width *= 2) {
+        for (std::size_t i = 0; i < chunks; i += width * 2) {
+            difference_type lo = bound(i), mid = bound(i + width), hi = bound(i + width * 2);
+            std::size_t pieces = std::max<std::size_t>(1, threads * 4 * width * 2 / chunks);
+            if (in_buffer) {
+                detail::parallel_merge(buffer.begin() + lo, mid - lo, buffer.begin() + mid, hi - mid, first + lo, less, executor, pieces, pending);
+            }
+            else {
+                detail::parallel_merge(first + lo, mid - lo, first + mid, hi - mid, buffer.begin() + lo, less, executor, pieces, pending);
+            }
+        }
+        detail::help_until_done(executor, pending);
+        in_buffer = !in_buffer;
+    }
+    if (in_buffer) {
+        for (std::size_t i = 0; i < chunks; ++i) {
+            pending.fetch_add(1, std::memory_order_relaxed);
+            executor.submit([&, i] {
+                std::move(buffer.begin() + bound(i), buffer.begin() + bound(i + 1), first + bound(i));
+                pending.fetch_sub(1, std::memory_order_release);
+            });
+        }
+        detail::help_until_done(executor, pending);
+    }
+}
+
+template <typename Iterator, typename Compare = std::less_equal<typename std::iterator_traits<Iterator>::value_type>>
+void parallel_merge_sort(Iterator first, Iterator last, Compare compare = Compare{}) {
+    parallel_merge_sort(first, last, compare, thread_pool::default_pool());
+}
+
+namespace detail {
+
+template <typename Iterator, typename Compare>
+void introselect(Iterator first, Iterator nth, Iterator last, Compare& compare, int bad_allowed);
+
+// median of the medians of groups of five, moved to *first: at least 3/10 of the range lies on either
+// side of it, which bounds selection to O(n) whatever the input
+template <typename Iterator, typename Compare>
+void median_of_medians(Iterator first, Iterator last, Compare& compare) {
+    auto len = last - first;
+    auto medians = first;
+    for (decltype(len) group = 0; group < len; group += 5) {
+        auto group_len = std::min<decltype(len)>(5, len - group);
+        insert_sort(first + group, first + group + group_len, compare);
+        std::swap(*medians++, *(first + group + group_len / 2));
+    }
+    auto middle = first + (medians - first) / 2;
+    introselect(first, middle, medians, compare, 0);
+    std::swap(*first, *middle);
+}
+
+// quickselect on the three-way partition, dropping to median-of-medians pivots after a few lopsided splits
+template <typename Iterator, typename Compare>
+void introselect(Iterator first, Iterator nth, Iterator last, Compare& compare, int bad_allowed) {
+    while (last - first > 16) {
+        auto len = last - first;
+        if (bad_allowed == 0) {
+            median_of_medians(first, last, compare);
+        }
+        else {
+            choose_pivot(first, last, compare);
+        }
+        auto bounds = pivot_partition(first, last, compare);
+        if (nth < bounds.first) {
+            last = bounds.first;
+        }
+        else if (nth >= bounds.second) {
+            first = bounds.second;
+        }
+        else {
+            return;
+        }
+        if (bad_allowed > 0 && last - first > len / 8 * 7) {
+            --bad_allowed;
+        }
+    }
+    insert_sort(first, last, compare);
+}
+
+}
+
+// rearranges [first, last) so *nth is the element a full sort would put there, nothing before it comes after it
+// and nothing after it comes before it; O(n) in the worst case
+template <typename Iterator, typename Compare = std::less_equal<typename std::iterator_traits<Iterator>::value_type>>
+void nth_element(Iterator first, Iterator nth, Iterator last, Compare compare = Compare{}) {
+    static_assert(std::is_same<typename std::iterator_traits<Iterator>::iterator_category, std::random_access_iterator_tag>::value, "only allow random iterator");
+    if (nth == last) {
+        return;
+    }
+    detail::introselect(first, nth, last, compare, 4);
+}
+
+// sorts the smallest middle - first elements into [first, middle), the rest is left in unspecified order.
+// a small k keeps the best k in a heap over [first, middle) and rejects most of the rest with one comparison,
+// O(n log k); a large k selects first and then sorts the prefix, O(n + k log k)
+template <typename Iterator, typename Compare = std::less_equal<typename std::iterator_traits<Iterator>::value_type>>
+void partial_sort(Iterator first, Iterator middle, Iterator last, Compare compare = Compare{}) {
+    static_assert(std::is_same<typename std::iterator_traits<Iterator>::iterator_category, std::random_access_iterator_tag>::value, "only allow random iterator");
+    if (first == middle) {
+        return;
+    }
+    if (middle == last) {
+        intro_sort(first, last, compare);
+        return;
+    }
+    if (middle - first > (last - first) / 128) {
+        tinystl::nth_element(first, middle - 1, last, compare);
+        intro_sort(first, middle - 1, compare);
+        return;
+    }
+    detail::flipped_order<Compare> worst_first{ compare };
+    tinystl::make_heap(first, middle, worst_first);
+    for (auto cur = middle; cur != last; ++cur) {
+        if (compare(*cur, *first) && !compare(*first, *cur)) {
+            std::swap(*cur, *first);
+            detail::heap_sift_down<4>(first, middle - first, 0, worst_first);
+        }
+    }
+    intro_sort(first, middle, compare);
+}
+
+// the k elements that come first under compare among everything pushed so far, for inputs that arrive
+// incrementally; kept in a heap with the worst of them at the root, so a push costs O(log k) at most
+// and O(1) for the common element that does not make the cut
+template <typename T, typename Compare = std::less_equal<T>>
+class top_k {
+public:
+    explicit top_k(std::size_t k, Compare compare = Compare{}) : k_(k), order_{ std::move(compare) } {
+        heap_.reserve(k);
+    }
+
+    void push(T value) {
+        if (heap_.size() < k_) {
+            heap_.push_back(std::move(value));
+            tinystl::push_heap(heap_.begin(), heap_.end(), order_);
+        }
+        else if (k_ > 0 && order_.less(value, heap_.front()) && !order_.less(heap_.front(), value)) {
+            heap_.front() = std::move(value);
+            detail::heap_sift_down<4>(heap_.begin(), heap_.end() - heap_.begin(), 0, order_);
+        }
+    }
+
+    template <typename Iterator>
+    void push(Iterator first, Iterator last) {
+        for (; first != last; ++first) {
+            push(*first);
+        }
+    }
+
+    std::size_t size() const noexcept { return heap_.size(); }
+    std::size_t k() const noexcept { return k_; }
+
+    // the kept elements in heap order, the worst one first
+    const vector<T>& values() const noexcept { return heap_; }
+
+    vector<T> sorted() const {
+        vector<T> result = heap_;
+        intro_sort(result.begin(), result.end(), order_.less);
+        return result;
+    }
+
+private:
+    std::size_t k_;
+    detail::flipped_order<Compare> order_;
+    vector<T> heap_;
+};
+
+namespace detail {
+
+struct identity_key {
+    template <typename T>
+    const T& operator()(const T& value) const noexcept { return value; }
+};
+
+// maps integer and floating point keys to unsigned integers with the same ordering
+template <typename Key, typename = void>
+struct radix_traits;
+
+template <typename Key>
+struct radix_traits<Key, typename std::enable_if<std::is_integral<Key>::value>::type> {
+    using unsigned_type = typename std::make_unsigned<Key>::type;
+    static unsigned_type transform(Key key) {
+        unsigned_type bits = static_cast<unsigned_type>(key);
+        if (std::is_signed<Key>::value) {
+            bits ^= unsigned_type(1) << (sizeof(Key) * 8 - 1);
+        }
+        return bits;
+    }
+};
+
+// positive floats only need the sign bit set, negative ones are flipped entirely to reverse their order.
+// -0.0 becomes +0.0 first: operator< holds them equal, so a stable sort has to keep them in input order
+template <typename Key>
+struct radix_traits<Key, typename std::enable_if<std::is_floating_point<Key>::value>::type> {
+    static_assert(sizeof(Key) == 4 || sizeof(Key) == 8, "only float and double keys are supported");
+    using unsigned_type = typename std::conditional<sizeof(Key) == 4, std::uint32_t, std::uint64_t>::type;
+    static unsigned_type transform(Key key) {
+        if (key == Key(0)) {
+            key = Key(0);
+        }
+        unsigned_type bits;
+        std::memcpy(&bits, &key, sizeof(Key));
+        unsigned_type sign = unsigned_type(1) << (sizeof(Key) * 8 - 1);
+        return bits & sign ? ~bits : bits | sign;
+    }
+};
+
+template <typename Iterator, typename KeyExtractor>
+void lsd_radix_sort(Iterator first, Iterator last, KeyExtractor key) {
+    using value_type = typename std::iterator_traits<Iterator>::value_type;
+    using key_type = typename std::decay<decltype(key(*first))>::type;
+    using traits = radix_traits<key_type>;
+    constexpr std::size_t passes = sizeof(typename traits::unsigned_type);
+    std::size_t len = last - first;
+
+    // one read of the input fills the histograms of every byte
+    std::array<std::array<std::size_t, 256>, passes> counts{};
+    for (auto cur = first; cur != last; ++cur) {
+        auto bits = traits::transform(key(*cur));
+        for (std::size_t pass = 0; pass < passes; ++pass) {
+            ++counts[pass][(bits >> (pass * 8)) & 0xff];
+        }
+    }
+
+    vector<value_type> buffer;
+    bool in_buffer = false;
+    for (std::size_t pass = 0; pass < passes; ++pass) {
+        auto& count = counts[pass];
+        // a byte that is the same for every element does not reorder anything
+        if (std::find(count.begin(), count.end(), len) != count.end()) {
+            continue;
+        }
+        if (buffer.empty()) {
+            buffer.assign(first, last);
+        }
+        std::array<std::size_t, 256> offsets;
+        std::size_t sum = 0;
+        for (std::size_t i = 0; i < 256; ++i) {
+            offsets[i] = sum;
+            sum += count[i];
+        }
+        auto scatter = [&](auto from, auto from_last, auto to) {
+            for (; from != from_last; ++from) {
+                auto byte = (traits::transform(key(*from)) >> (pass * 8)) & 0xff;
+                *(to + offsets[byte]++) = std::move(*from);
+            }
+        };
+        if (in_buffer) {
+            scatter(buffer.begin(), buffer.end(), first);
+        }
+        else {
+            scatter(first, last, buffer.begin());
+        }
+        in_buffer = !in_buffer;
+    }
+    if (in_buffer) {
+        std::move(buffer.begin(), buffer.end(), first);
+    }
+}
+
+inline int radix_char_at(std::string_view key, std::size_t depth) {
+    return depth < key.size() ? static_cast<unsigned char>(key[depth]) + 1 : 0;
+}
+
+// stable MSD counting sort on the byte at depth, bucket 0 holds the strings that already ended
+template <typename Iterator, typename BufferIterator, typename KeyExtractor>
+void msd_radix_sort(Iterator first, Iterator last, BufferIterator buffer, std::size_t depth, KeyExtractor& key) {
+    using value_type = typename std::iterator_traits<Iterator>::value_type;
+    if (last - first <= 32) {
+        insert_sort(first, last, [&](const value_type& a, const value_type& b) {
+            return std::string_view(key(a)).substr(std::min(depth, std::string_view(key(a)).size())) <
+                   std::string_view(key(b)).substr(std::min(depth, std::string_view(key(b)).size()));
+        });
+        return;
+    }
+    std::array<std::size_t, 258> offsets{};
+    for (auto cur = first; cur != last; ++cur) {
+        ++offsets[radix_char_at(key(*cur), depth) + 1];
+    }
+    for (std::size_t i = 1; i < offsets.size(); ++i) {
+        offsets[i] += offsets[i - 1];
+    }
+    auto starts = offsets;
+    for (auto cur = first; cur != last; ++cur) {
+        *(buffer + starts[radix_char_at(key(*cur), depth)]++) = std::move(*cur);
+    }
+    std::move(buffer, buffer + (last - first), first);
+    for (std::size_t bucket = 1; bucket < 257; ++bucket) {
+        if (offsets[bucket + 1] - offsets[bucket] > 1) {
+            msd_radix_sort(first + offsets[bucket], first + offsets[bucket + 1], buffer + offsets[bucket], depth + 1, key);
+        }
+    }
+}
+
+template <typename Iterator, typename KeyExtractor>
+void radix_sort_impl(Iterator first, Iterator last, KeyExtractor key, std::true_type) {
+    using value_type = typename std::iterator_traits<Iterator>::value_type;
+    vector<value_type> buffer(first, last);
+    msd_radix_sort(first, last, buffer.begin(), 0, key);
+}
+
+template <typename Iterator, typename KeyExtractor>
+void radix_sort_impl(Iterator first, Iterator last, KeyExtractor key, std::false_type) {
+    lsd_radix_sort(first, last, key);
+}
+
+}
+
+// stable ascending radix sort: LSD byte passes for integer and floating point keys, MSD for string keys;
+// key extracts the sort key from an element, e.g. [](const record& r) -> const std::string& { return r.name; }
+template <typename Iterator, typename KeyExtractor = detail::identity_key>
+void radix_sort(Iterator first, Iterator last, KeyExtractor key = KeyExtractor{}) {
+    static_assert(std::is_same<typename std::iterator_traits<Iterator>::iterator_category, std::random_access_iterator_tag>::value, "only allow random iterator");
+    using key_type = typename std::decay<decltype(key(*first))>::type;
+    using is_string_key = std::is_convertible<key_type, std::string_view>;
+    static_assert(is_string_key::value || std::is_arithmetic<key_type>::value, "radix_sort needs an arithmetic or string key");
+    if (last - first <= 1) {
+        return;
+    }
+    detail::radix_sort_impl(first, last, key, is_string_key{});
+}
+
+namespace detail {
+
+template <typename Iterator, typename KeyExtractor>
+using key_type_t = typename std::decay<decltype(std::declval<KeyExtractor&>()(*std::declval<Iterator&>()))>::type;
+
+// the natural ascending order on a key radix_sort understands, where the radix pass replaces comparisons
+template <typename Key, typename Compare>
+struct use_radix_order : std::integral_constant<bool,
+    (std::is_arithmetic<Key>::value || std::is_convertible<Key, std::string_view>::value) &&
+    (std::is_same<Compare, std::less<Key>>::value || std::is_same<Compare, std::less_equal<Key>>::value ||
+     std::is_same<Compare, std::less<>>::value || std::is_same<Compare, std::less_equal<>>::value)> {};
+
+}
+
+// stable indirect sort: order[i] is the index of the element that belongs at position i. only the compact
+// (key, index) pairs are sorted, radix sorted for natural orders on arithmetic and string keys
+template <typename Iterator, typename KeyExtractor = detail::identity_key,
+          typename Compare = std::less_equal<detail::key_type_t<Iterator, KeyExtractor>>>
+vector<std::size_t> argsort(Iterator first, Iterator last, KeyExtractor key = KeyExtractor{}, Compare compare = Compare{}) {
+    static_assert(std::is_same<typename std::iterator_traits<Iterator>::iterator_category, std::random_access_iterator_tag>::value, "only allow random iterator");
+    using key_type = detail::key_type_t<Iterator, KeyExtractor>;
+    using entry = std::pair<key_type, std::size_t>;
+    vector<entry> entries;
+    entries.reserve(last - first);
+    for (auto cur = first; cur != last; ++cur) {
+        entries.emplace_back(key(*cur), entries.size());
+    }
+    if constexpr (detail::use_radix_order<key_type, Compare>::value) {
+        radix_sort(entries.begin(), entries.end(), [](const entry& e) -> const key_type& { return e.first; });
+    }
+    else {
+        natural_merge_sort(entries.begin(), entries.end(), [&compare](const entry& a, const entry& b) { return compare(a.first, b.first); });
+    }
+    vector<std::size_t> order;
+    order.reserve(entries.size());
+    for (auto& e : entries) {
+        order.push_back(e.second);
+    }
+    return order;
+}
+
+// moves the element at order[i] to position i in every column at once, following each cycle of the
+// permutation so every element moves exactly once; order is used up as the visited marks
+template <typename... Columns>
+void permute(vector<std::size_t> order, Columns... columns) {
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        if (order[i] == i) {
+            continue;
+        }
+        auto held = std::make_tuple(std::move(*(columns + i))...);
+        std::size_t hole = i;
+        while (order[hole] != i) {
+            std::size_t next = order[hole];
+            ((*(columns + hole) = std::move(*(columns + next))), ...);
+            order[hole] = hole;
+            hole = next;
+        }
+        order[hole] = hole;
+        std::apply([&](auto&... values) { ((*(columns + hole) = std::move(values)), ...); }, held);
+    }
+}
+
+// sorts wide records through argsort: the sort itself only touches keys and indices and every record
+// is moved once, instead of once per exchange
+template <typename Iterator, typename KeyExtractor, typename Compare = std::less_equal<detail::key_type_t<Iterator, KeyExtractor>>>
+void indirect_sort(Iterator first, Iterator last, KeyExtractor key, Compare compare = Compare{}) {
+    permute(argsort(first, last, key, compare), first);
+}
+
+// struct-of-arrays sort: orders [key_first, key_last) and applies the same permutation to every other column
+template <typename KeyIterator, typename... Columns>
+void sort_columns(KeyIterator key_first, KeyIterator key_last, Columns... columns) {
+    permute(argsort(key_first, key_last), key_first, columns...);
+}
+
+template <typename Compare, typename KeyIterator, typename... Columns>
+void sort_columns_by(Compare compare, KeyIterator key_first, KeyIterator key_last, Columns... columns) {
+    permute(argsort(key_first, key_last, detail::identity_key{}, compare), key_first, columns...);
+}
+
+
+template <typename Iterator, typename Compare = std::less_equal<typename std::iterator_traits<Iterator>::value_type>>
+void select_sort(Iterator first, Iterator last, Compare compare = Compare{}) {
+    static_assert(std::is_same<typename std::iterator_traits<Iterator>::iterator_category, std::random_access_iterator_tag>::value, "only allow random iterator");
+    auto right = last - 1;
+    while (right > first) {
+        auto max_iter = first;
+        auto cur = first + 1;
+        while (cur <= right) {
+            if (compare(*max_iter, *cur)) {
+                max_iter = cur;
+            }
+            ++cur;
+        }
+        std::swap(*max_iter, *right);
+        --right;
+    }
+}
+
+template <typename Iterator, typename Compare = std::less_equal<typename std::iterator_traits<Iterator>::value_type>>
+void bubble_sort(Iterator first, Iterator last, Compare compare = Compare{}) {
+    static_assert(std::is_same<typename std::iterator_traits<Iterator>::iterator_category, std::random_access_iterator_tag>::value, "only allow random iterator");
+    auto right = last - 1;
+    while (right > first) {
+        auto cur = first + 1;
+        while (cur <= right) {
+            if (compare(*cur, *(cur - 1))) {
+                std::swap(*cur, *(cur - 1));
+            }
+            ++cur;
+        }
+        --right;
+    }
+}
+
+void bubble_sort(vector<int>& nums) {
+    for (int i = 0; i < nums.size() - 1; ++i) {
+        for (int j = 1; j < nums.size() - i; ++j) {
+            if (nums[j] < nums[j - 1]) {
+                std::swap(nums[j], nums[j - 1]);
+            }
+        }
+    }
+}
+
+void select_sort(vector<int>& nums) {
+    for (int i = 0; i < nums.size() - 1; ++i) {
+        auto max_iter = std::max_element(nums.begin(), nums.end() - i);
+        std::swap(*max_iter, *(nums.end() - i - 1));
+    }
+}
+
+void insert_sort(vector<int>& nums) {
+    int cur = 0;
+    for (int i = 1; i < nums.size(); ++i) {
+        int value = nums[i];
+        int cur = i;
+        int prev = i - 1;
+        while (cur > 0 && nums[prev] > value) {
+            nums[cur] = nums[prev];
+            --cur;
+            --prev;
+        }
+        nums[cur] = value;
+    }
+}
+
+// gap sequences for shell_sort: small_gaps are compile-time constants, descending, so their passes are
+// instantiated with a constant stride; large_gaps writes the runtime gaps below len into gaps, ascending,
+// and returns how many there are
+namespace shell_gaps {
+
+// n/2, n/4, ..., 1: the textbook sequence, O(n^2) in the worst case
+struct halving {
+    using small_gaps = std::index_sequence<>;
+
+    static std::size_t large_gaps(std::size_t len, std::array<std::size_t, 64>& gaps) {
+        std::size_t count = 0;
+        for (std::size_t gap = len / 2; gap > 0; gap /= 2) {
+            gaps[count++] = gap;
+        }
+        std::reverse(gaps.begin(), gaps.begin() + count);
+        return count;
+    }
+};
+
+// Ciura's empirically tuned gaps, extended by a factor of 2.25 past 1750
+struct ciura {
+    using small_gaps = std::index_sequence<57, 23, 10, 4, 1>;
+
+    static std::size_t large_gaps(std::size_t len, std::array<std::size_t, 64>& gaps) {
+        std::size_t count = 0;
+        for (std::size_t gap : { 132, 301, 701, 1750 }) {
+            if (gap < len) {
+                gaps[count++] = gap;
+            }
+        }
+        for (double gap = 1750 * 2.25; gap < len; gap *= 2.25) {
+            gaps[count++] = static_cast<std::size_t>(gap);
+        }
+        return count;
+    }
+};
+
+// Tokuda: ceil(h) for h(k) = 2.25 h(k - 1) + 1, h(1) = 1
+struct tokuda {
+    using small_gaps = std::index_sequence<46, 20, 9, 4, 1>;
+
+    static std::size_t large_gaps(std::size_t len, std::array<std::size_t, 64>& gaps) {
+        std::size_t count = 0;
+        double h = 1;
+        while (std::ceil(h) <= 46) {
+            h = h * 2.25 + 1;
+        }
+        for (; std::ceil(h) < len; h = h * 2.25 + 1) {
+            gaps[count++] = static_cast<std::size_t>(std::ceil(h));
+        }
+        return count;
+    }
+};
+
+// Sedgewick 1986: 4^k + 3 * 2^(k - 1) + 1, O(n^(4/3)) in the worst case
+struct sedgewick {
+    using small_gaps = std::index_sequence<77, 23, 8, 1>;
+
+    static std::size_t large_gaps(std::size_t len, std::array<std::size_t, 64>& gaps) {
+        std::size_t count = 0;
+        for (std::size_t k = 4; k < 31; ++k) {
+            std::size_t gap = (std::size_t(1) << (2 * k)) + 3 * (std::size_t(1) << (k - 1)) + 1;
+            if (gap >= len) {
+                break;
+            }
+            gaps[count++] = gap;
+        }
+        return count;
+    }
+};
+
+}
+
+namespace detail {
+
+// one gapped insertion sort pass, Gap is either a std::size_t or a std::integral_constant
+template <typename Iterator, typename Gap, typename Less>
+void shell_pass(Iterator first, std::size_t len, Gap gap, const Less& less) {
+    const std::size_t step = gap;
+    for (std::size_t i = step; i < len; ++i) {
+        auto value = std::move(*(first + i));
+        std::size_t hole = i;
+        while (hole >= step && less(value, *(first + (hole - step)))) {
+            *(first + hole) = std::move(*(first + (hole - step)));
+            hole -= step;
+        }
+        *(first + hole) = std::move(value);
+    }
+}
+
+template <typename Iterator, typename Less, std::size_t... Gaps>
+void shell_small_passes([[maybe_unused]] Iterator first, [[maybe_unused]] std::size_t len, [[maybe_unused]] const Less& less, std::index_sequence<Gaps...>) {
+    ((Gaps < len ? shell_pass(first, len, std::integral_constant<std::size_t, Gaps>{}, less) : void()), ...);
+}
+
+}
+
+// in-place, allocation-free shell sort, e.g. shell_sort<shell_gaps::tokuda>(first, last)
+template <typename Gaps = shell_gaps::ciura, typename Iterator, typename Compare = std::less_equal<typename std::iterator_traits<Iterator>::value_type>>
+void shell_sort(Iterator first, Iterator last, Compare compare = Compare{}) {
+    static_assert(std::is_same<typename std::iterator_traits<Iterator>::iterator_category, std::random_access_iterator_tag>::value, "only allow random iterator");
+    auto len = static_cast<std::size_t>(last - first);
+    if (len <= 1) {
+        return;
+    }
+    detail::strict_order<Compare> less(compare, *first);
+    std::array<std::size_t, 64> gaps;
+    for (auto count = Gaps::large_gaps(len, gaps); count > 0; --count) {
+        detail::shell_pass(first, len, gaps[count - 1], less);
+    }
+    detail::shell_small_passes(first, len, less, typename Gaps::small_gaps{});
+}
+
+namespace detail {
+
+// merges two null-terminated lists by relinking, ties are taken from a so the sort stays stable
+template <typename Node, typename Less>
+Node* merge_lists(Node* a, Node* b, Node* Node::*next, const Less& less) {
+    Node* head = nullptr;
+    Node** tail = &head;
+    while (a != nullptr && b != nullptr) {
+        if (less(*b, *a)) {
+            *tail = b;
+            tail = &(b->*next);
+            b = b->*next;
+        }
+        else {
+            *tail = a;
+            tail = &(a->*next);
+            a = a->*next;
+        }
+    }
+    *tail = a != nullptr ? a : b;
+    return head;
+}
+
+}
+
+// stable merge sort of a null-terminated singly linked list, returns the new head. nodes are relinked through
+// the next member and payloads never move; bottom-up like a binary counter, bins[i] holds a sorted list of 2^i
+// nodes, so the extra space is the fixed array of 64 bins and no recursion. compare takes two nodes
+template <typename Node, typename Compare>
+Node* list_merge_sort(Node* head, Node* Node::*next, Compare compare) {
+    if (head == nullptr || head->*next == nullptr) {
+        return head;
+    }
+    detail::strict_order<Compare> less(compare, *head);
+    Node* bins[64] = {};
+    std::size_t fill = 0;
+    while (head != nullptr) {
+        Node* carry = head;
+        head = head->*next;
+        carry->*next = nullptr;
+        std::size_t i = 0;
+        for (; i < fill && bins[i] != nullptr; ++i) {
+            carry = detail::merge_lists(bins[i], carry, next, less);
+            bins[i] = nullptr;
+        }
+        bins[i] = carry;
+        if (i == fill) {
+            ++fill;
+        }
+    }
+    Node* result = nullptr;
+    for (std::size_t i = 0; i < fill; ++i) {
+        if (bins[i] != nullptr) {
+            result = detail::merge_lists(bins[i], result, next, less);
+        }
+    }
+    return result;
+}
+
+// doubly linked version: sorts through next and rebuilds prev in one final pass, returns the new head and tail
+template <typename Node, typename Compare>
+std::pair<Node*, Node*> list_merge_sort(Node* head, Node* Node::*next, Node* Node::*prev, Compare compare) {
+    head = list_merge_sort(head, next, compare);
+    Node* tail = nullptr;
+    for (Node* cur = head; cur != nullptr; cur = cur->*next) {
+        cur->*prev = tail;
+        tail = cur;
+    }
+    return std::make_pair(head, tail);
+}
+
+}
@@ -0,0 +1,348 @@
+// g++ -std=c++17 -O2 -pthread sort_bench.cpp -o sort_bench -ltbb
+// ./sort_bench [element count] [thread count]
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <list>
+#include <random>
+#include <string>
+#include <vector>
+#if __has_include(<execution>)
+#include <execution>
+#endif
+
+#include "sort.hpp"
+
+template <typename Func>
+double measure_ms(Func&& func) {
+    auto start = std::chrono::steady_clock::now();
+    func();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+template <typename T, typename Sort>
+void run(const std::string& name, const std::vector<T>& input, const std::vector<T>& expected, Sort&& sort) {
+    auto data = input;
+    double ms = measure_ms([&] { sort(data); });
+    std::cout << name << "\t" << ms << " ms\t" << ms * 1e6 / input.size() << " ns/element"
+              << (data == expected ? "" : "\tWRONG RESULT") << "\n";
+}
+
+template <typename T>
+std::vector<T> make_input(const std::string& distribution, std::size_t count, std::mt19937_64& engine) {
+    std::vector<T> input(count);
+    for (auto& value : input) {
+        value = static_cast<T>(distribution == "few_unique" ? engine() % 16 : engine() >> 1);
+    }
+    if (distribution == "sorted") {
+        std::sort(input.begin(), input.end());
+    }
+    return input;
+}
+
+// the generic comparator is not a standard ordering, so it keeps the branchy three-way partition
+template <typename T>
+void key_bench(const std::string& type, std::size_t count, std::mt19937_64& engine) {
+    for (std::string distribution : { "random", "few_unique", "sorted" }) {
+        auto input = make_input<T>(distribution, count, engine);
+        auto expected = input;
+        std::sort(expected.begin(), expected.end());
+        std::cout << count << " " << type << " keys, " << distribution << "\n";
+        run("tinystl::intro_sort(branchy)", input, expected, [](auto& data) {
+            tinystl::intro_sort(data.begin(), data.end(), [](const T& a, const T& b) { return a <= b; });
+        });
+        run("tinystl::intro_sort(block)", input, expected, [](auto& data) {
+            tinystl::intro_sort(data.begin(), data.end(), std::less<T>{});
+        });
+        run("tinystl::radix_sort", input, expected, [](auto& data) {
+            tinystl::radix_sort(data.begin(), data.end());
+        });
+        run("std::sort", input, expected, [](auto& data) {
+            std::sort(data.begin(), data.end());
+        });
+    }
+}
+
+// stable sorts on random keys and on log-like input made of a few long sorted runs
+void merge_bench(std::size_t count, std::mt19937_64& engine, tinystl::thread_pool& pool) {
+    for (std::string distribution : { "random", "sorted_runs" }) {
+        auto input = make_input<std::uint64_t>(distribution == "random" ? "random" : "sorted", count, engine);
+        if (distribution == "sorted_runs") {
+            std::size_t run = count / 16 + 1;
+            for (std::size_t i = 0; i < count; i += run) {
+                std::rotate(input.begin() + i, input.begin() + i + std::min(run, count - i) / 2, input.begin() + std::min(i + run, count));
+            }
+        }
+        auto expected = input;
+        std::stable_sort(expected.begin(), expected.end());
+        std::cout << count << " uint64 keys, " << distribution << "\n";
+        run("tinystl::merge_sort", input, expected, [](auto& data) {
+            tinystl::merge_sort(data.begin(), data.end());
+        });
+        run("tinystl::natural_merge_sort", input, expected, [](auto& data) {
+            tinystl::natural_merge_sort(data.begin(), data.end());
+        });
+        run("tinystl::parallel_merge_sort", input, expected, [&](auto& data) {
+            tinystl::parallel_merge_sort(data.begin(), data.end(), std::less_equal<std::uint64_t>{}, pool);
+        });
+        run("std::stable_sort", input, expected, [](auto& data) {
+            std::stable_sort(data.begin(), data.end());
+        });
+#if defined(__cpp_lib_execution) && __cpp_lib_execution >= 201603L
+        run("std::stable_sort(par)", input, expected, [](auto& data) {
+            std::stable_sort(std::execution::par, data.begin(), data.end());
+        });
+#endif
+    }
+}
+
+// the k smallest keys in order, compared with sorting everything and taking the prefix
+void select_bench(std::size_t count, std::mt19937_64& engine) {
+    auto input = make_input<std::uint64_t>("random", count, engine);
+    auto expected = input;
+    std::sort(expected.begin(), expected.end());
+    for (std::size_t k : { std::size_t(10), std::size_t(1000), count / 10 }) {
+        k = std::min(k, count);
+        auto select = [&](const std::string& name, auto&& top) {
+            auto data = input;
+            std::vector<std::uint64_t> result;
+            double ms = measure_ms([&] { result = top(data); });
+            std::cout << name << "\t" << ms << " ms\t" << ms * 1e6 / count << " ns/element"
+                      << (std::equal(result.begin(), result.end(), expected.begin(), expected.begin() + k) ? "" : "\tWRONG RESULT") << "\n";
+        };
+        std::cout << count << " uint64 keys, smallest " << k << "\n";
+        select("tinystl::quick_sort + prefix", [k](auto& data) {
+            tinystl::quick_sort(data.begin(), data.end());
+            return std::vector<std::uint64_t>(data.begin(), data.begin() + k);
+        });
+        select("tinystl::partial_sort", [k](auto& data) {
+            tinystl::partial_sort(data.begin(), data.begin() + k, data.end());
+            return std::vector<std::uint64_t>(data.begin(), data.begin() + k);
+        });
+        select("tinystl::top_k", [k](auto& data) {
+            tinystl::top_k<std::uint64_t> top(k);
+            top.push(data.begin(), data.end());
+            return top.sorted();
+        });
+        select("std::partial_sort", [k](auto& data) {
+            std::partial_sort(data.begin(), data.begin() + k, data.end());
+            return std::vector<std::uint64_t>(data.begin(), data.begin() + k);
+        });
+        select("tinystl::nth_element + sort", [k](auto& data) {
+            tinystl::nth_element(data.begin(), data.begin() + k - 1, data.end());
+            std::sort(data.begin(), data.begin() + k);
+            return std::vector<std::uint64_t>(data.begin(), data.begin() + k);
+        });
+        select("std::nth_element + sort", [k](auto& data) {
+            std::nth_element(data.begin(), data.begin() + k - 1, data.end());
+            std::sort(data.begin(), data.begin() + k);
+            return std::vector<std::uint64_t>(data.begin(), data.begin() + k);
+        });
+    }
+}
+
+struct record {
+    std::uint64_t key;
+    char payload[120];
+
+    bool operator==(const record& other) const { return key == other.key; }
+};
+
+// 128-byte records: direct sorts move the whole record on every exchange, indirect_sort moves it once
+void record_bench(std::size_t count, std::mt19937_64& engine) {
+    auto keys = make_input<std::uint64_t>("random", count, engine);
+    std::vector<record> input(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        input[i].key = keys[i];
+    }
+    auto expected = input;
+    std::sort(expected.begin(), expected.end(), [](const record& a, const record& b) { return a.key < b.key; });
+    std::cout << count << " 128-byte records\n";
+    run("tinystl::quick_sort", input, expected, [](auto& data) {
+        tinystl::quick_sort(data.begin(), data.end(), [](const record& a, const record& b) { return a.key <= b.key; });
+    });
+    run("tinystl::merge_sort", input, expected, [](auto& data) {
+        tinystl::merge_sort(data.begin(), data.end(), [](const record& a, const record& b) { return a.key <= b.key; });
+    });
+    run("tinystl::indirect_sort", input, expected, [](auto& data) {
+        tinystl::indirect_sort(data.begin(), data.end(), [](const record& r) { return r.key; });
+    });
+    run("std::sort", input, expected, [](auto& data) {
+        std::sort(data.begin(), data.end(), [](const record& a, const record& b) { return a.key < b.key; });
+    });
+
+    // the same three fields as separate columns
+    std::vector<std::uint64_t> column_keys = keys;
+    std::vector<std::uint32_t> ids(count);
+    std::vector<double> scores(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        ids[i] = static_cast<std::uint32_t>(i);
+        scores[i] = static_cast<double>(keys[i] % 1000);
+    }
+    double ms = measure_ms([&] { tinystl::sort_columns(column_keys.begin(), column_keys.end(), ids.begin(), scores.begin()); });
+    bool correct = std::is_sorted(column_keys.begin(), column_keys.end()) && keys[ids[count / 2]] == column_keys[count / 2];
+    std::cout << "tinystl::sort_columns(3 columns)\t" << ms << " ms\t" << ms * 1e6 / count << " ns/element"
+              << (correct ? "" : "\tWRONG RESULT") << "\n";
+}
+
+struct list_node {
+    std::uint64_t key;
+    std::uint64_t shuffle;
+    list_node* next;
+};
+
+// linked lists whose nodes are linked in allocation order or scattered across memory by a shuffle
+void list_bench(std::size_t count, std::mt19937_64& engine) {
+    for (std::string layout : { "sequential", "scattered" }) {
+        std::vector<list_node> nodes(count);
+        std::list<std::pair<std::uint64_t, std::uint64_t>> list;
+        for (auto& node : nodes) {
+            node.key = engine();
+            node.shuffle = layout == "sequential" ? 0 : engine();
+            list.emplace_back(node.key, node.shuffle);
+        }
+        std::vector<list_node*> links(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            links[i] = &nodes[i];
+        }
+        std::stable_sort(links.begin(), links.end(), [](const list_node* a, const list_node* b) { return a->shuffle < b->shuffle; });
+        for (std::size_t i = 0; i < count; ++i) {
+            links[i]->next = i + 1 < count ? links[i + 1] : nullptr;
+        }
+        list.sort([](const auto& a, const auto& b) { return a.second < b.second; });
+
+        std::cout << count << " list nodes, " << layout << "\n";
+        list_node* head = count == 0 ? nullptr : links[0];
+        double ms = measure_ms([&] {
+            head = tinystl::list_merge_sort(head, &list_node::next, [](const list_node& a, const list_node& b) { return a.key <= b.key; });
+        });
+        bool correct = true;
+        for (auto* node = head; node != nullptr && node->next != nullptr; node = node->next) {
+            correct = correct && node->key <= node->next->key;
+        }
+        std::cout << "tinystl::list_merge_sort\t" << ms << " ms\t" << ms * 1e6 / count << " ns/element"
+                  << (correct ? "" : "\tWRONG RESULT") << "\n";
+        ms = measure_ms([&] { list.sort([](const auto& a, const auto& b) { return a.first < b.first; }); });
+        std::cout << "std::list::sort\t" << ms << " ms\t" << ms * 1e6 / count << " ns/element\n";
+    }
+}
+
+// Ciura's gaps with every pass at a runtime stride, to measure the constant-stride small passes
+struct ciura_runtime_gaps {
+    using small_gaps = std::index_sequence<>;
+
+    static std::size_t large_gaps(std::size_t len, std::array<std::size_t, 64>& gaps) {
+        std::size_t count = 0;
+        for (std::size_t gap : { 1, 4, 10, 23, 57 }) {
+            if (gap < len) {
+                gaps[count++] = gap;
+            }
+        }
+        std::array<std::size_t, 64> large;
+        std::size_t large_count = tinystl::shell_gaps::ciura::large_gaps(len, large);
+        std::copy(large.begin(), large.begin() + large_count, gaps.begin() + count);
+        return count + large_count;
+    }
+};
+
+template <typename T>
+void shell_bench(const std::string& type, std::size_t count, std::mt19937_64& engine) {
+    for (std::string distribution : { "random", "few_unique" }) {
+        auto input = make_input<T>(distribution, count, engine);
+        auto expected = input;
+        std::sort(expected.begin(), expected.end());
+        std::cout << count << " " << type << " keys, " << distribution << "\n";
+        run("tinystl::shell_sort<halving>", input, expected, [](auto& data) {
+            tinystl::shell_sort<tinystl::shell_gaps::halving>(data.begin(), data.end());
+        });
+        run("tinystl::shell_sort<ciura, runtime gaps>", input, expected, [](auto& data) {
+            tinystl::shell_sort<ciura_runtime_gaps>(data.begin(), data.end());
+        });
+        run("tinystl::shell_sort<ciura>", input, expected, [](auto& data) {
+            tinystl::shell_sort<tinystl::shell_gaps::ciura>(data.begin(), data.end());
+        });
+        run("tinystl::shell_sort<tokuda>", input, expected, [](auto& data) {
+            tinystl::shell_sort<tinystl::shell_gaps::tokuda>(data.begin(), data.end());
+        });
+        run("tinystl::shell_sort<sedgewick>", input, expected, [](auto& data) {
+            tinystl::shell_sort<tinystl::shell_gaps::sedgewick>(data.begin(), data.end());
+        });
+        run("tinystl::heap_sort", input, expected, [](auto& data) {
+            tinystl::heap_sort(data.begin(), data.end());
+        });
+    }
+}
+
+// many independent tiny sorts, where the leaf sort is the whole cost
+template <typename T>
+void small_batch_bench(const std::string& type, std::size_t count, std::mt19937_64& engine) {
+    auto input = make_input<T>("random", count, engine);
+    for (std::size_t batch : { 8, 16, 32, 64 }) {
+        auto expected = input;
+        for (std::size_t i = 0; i + batch <= count; i += batch) {
+            std::sort(expected.begin() + i, expected.begin() + i + batch);
+        }
+        std::cout << count << " " << type << " keys in batches of " << batch << "\n";
+        run("tinystl::insert_sort", input, expected, [batch](auto& data) {
+            for (std::size_t i = 0; i + batch <= data.size(); i += batch) {
+                tinystl::insert_sort(data.begin() + i, data.begin() + i + batch);
+            }
+        });
+        run("tinystl::quick_sort(network)", input, expected, [batch](auto& data) {
+            for (std::size_t i = 0; i + batch <= data.size(); i += batch) {
+                tinystl::quick_sort(data.begin() + i, data.begin() + i + batch);
+            }
+        });
+    }
+}
+
+int main(int argc, char** argv) {
+    std::size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+    std::size_t threads = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : std::thread::hardware_concurrency();
+
+    std::mt19937_64 engine(42);
+    std::vector<std::uint64_t> input(count);
+    for (auto& value : input) {
+        value = engine();
+    }
+    auto expected = input;
+    std::sort(expected.begin(), expected.end());
+
+    tinystl::thread_pool pool(threads);
+    std::cout << count << " uint64 keys, " << pool.size() << " threads\n";
+    run("tinystl::quick_sort", input, expected, [](auto& data) {
+        tinystl::quick_sort(data.begin(), data.end());
+    });
+    run("tinystl::intro_sort", input, expected, [](auto& data) {
+        tinystl::intro_sort(data.begin(), data.end());
+    });
+    run("tinystl::parallel_quick_sort", input, expected, [&](auto& data) {
+        tinystl::parallel_quick_sort(data.begin(), data.end(), std::less_equal<std::uint64_t>{}, pool);
+    });
+#if defined(__cpp_lib_execution) && __cpp_lib_execution >= 201603L
+    run("std::sort(par)", input, expected, [](auto& data) {
+        std::sort(std::execution::par, data.begin(), data.end());
+    });
+#endif
+
+    key_bench<std::int32_t>("int32", count, engine);
+    key_bench<std::int64_t>("int64", count, engine);
+    key_bench<double>("double", count, engine);
+
+    merge_bench(count, engine, pool);
+
+    select_bench(count, engine);
+
+    record_bench(count / 4, engine);
+
+    list_bench(count, engine);
+
+    shell_bench<std::int32_t>("int32", count / 10, engine);
+    shell_bench<double>("double", count / 10, engine);
+
+    small_batch_bench<std::int32_t>("int32", count, engine);
+    small_batch_bench<double>("double", count, engine);
+    return 0;
+}
@@ -0,0 +1,459 @@
+// g++ -std=c++17 -O2 -pthread sort_harness.cpp -o sort_harness
+// ./sort_harness [max element count] > results.csv
+//
+// runs every tinystl sort over several distributions, sizes and element types and writes one csv row per run;
+// every result is checked against std::sort (std::stable_sort for the stable sorts) and the exit code is 1
+// when any run was wrong. nth_element, partial_sort and top_k are checked for the k smallest elements at the
+// front, argsort through the permutation it returns and list_merge_sort on a list built from the input. ns/element and peak memory come from a plain run with the default comparator;
+// comparisons and moves come from a second run over an instrumented element type, which takes the generic
+// code paths (no block partition or sorting network), so they describe the algorithm and not the fast paths.
+// external_sort rows go through files in the temp dir with a budget of a few kilobytes, so every size above a
+// few thousand elements needs several merge passes; they have no move count
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "external_sort.hpp"
+#include "sort.hpp"
+
+// heap accounting: every allocation carries its size in a header so delete can subtract it again
+namespace {
+
+std::atomic<std::size_t> current_bytes{0};
+std::atomic<std::size_t> peak_bytes{0};
+
+constexpr std::size_t header = alignof(std::max_align_t);
+
+void* counted_alloc(std::size_t size) {
+    auto* base = static_cast<char*>(std::malloc(size + header));
+    if (base == nullptr) {
+        throw std::bad_alloc();
+    }
+    *reinterpret_cast<std::size_t*>(base) = size;
+    std::size_t now = current_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+    std::size_t peak = peak_bytes.load(std::memory_order_relaxed);
+    while (now > peak && !peak_bytes.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {
+    }
+    return base + header;
+}
+
+void counted_free(void* p) noexcept {
+    if (p != nullptr) {
+        auto* base = static_cast<char*>(p) - header;
+        current_bytes.fetch_sub(*reinterpret_cast<std::size_t*>(base), std::memory_order_relaxed);
+        std::free(base);
+    }
+}
+
+}
+
+void* operator new(std::size_t size) { return counted_alloc(size); }
+void* operator new[](std::size_t size) { return counted_alloc(size); }
+void operator delete(void* p) noexcept { counted_free(p); }
+void operator delete[](void* p) noexcept { counted_free(p); }
+void operator delete(void* p, std::size_t) noexcept { counted_free(p); }
+void operator delete[](void* p, std::size_t) noexcept { counted_free(p); }
+
+std::atomic<std::uint64_t> move_count{0};
+
+// element that counts copies and moves, index remembers the input position for the stability check
+template <typename T>
+struct counted {
+    T value{};
+    std::uint32_t index = 0;
+
+    counted() = default;
+    counted(T v, std::uint32_t i) : value(std::move(v)), index(i) {}
+    counted(const counted& other) : value(other.value), index(other.index) { move_count.fetch_add(1, std::memory_order_relaxed); }
+    counted(counted&& other) noexcept : value(std::move(other.value)), index(other.index) { move_count.fetch_add(1, std::memory_order_relaxed); }
+
+    counted& operator=(const counted& other) {
+        value = other.value;
+        index = other.index;
+        move_count.fetch_add(1, std::memory_order_relaxed);
+        return *this;
+    }
+
+    counted& operator=(counted&& other) noexcept {
+        value = std::move(other.value);
+        index = other.index;
+        move_count.fetch_add(1, std::memory_order_relaxed);
+        return *this;
+    }
+
+    bool operator==(const counted& other) const { return value == other.value && index == other.index; }
+};
+
+// the header's default comparator, counting every call
+template <typename T>
+struct counting_less_equal {
+    std::atomic<std::uint64_t>* count;
+
+    bool operator()(const counted<T>& a, const counted<T>& b) const {
+        count->fetch_add(1, std::memory_order_relaxed);
+        return a.value <= b.value;
+    }
+};
+
+template <typename T>
+T make_key(std::uint64_t raw) {
+    if constexpr (std::is_same<T, std::string>::value) {
+        return std::to_string(raw);
+    }
+    else if constexpr (std::is_floating_point<T>::value) {
+        return static_cast<T>(static_cast<std::int64_t>(raw)) / 7;
+    }
+    else {
+        return static_cast<T>(raw);
+    }
+}
+
+template <typename T>
+std::vector<T> make_input(const std::string& distribution, std::size_t count, std::mt19937_64& engine) {
+    std::vector<T> input;
+    input.reserve(count);
+    if (distribution == "few_unique") {
+        for (std::size_t i = 0; i < count; ++i) {
+            input.push_back(make_key<T>(engine() % 16));
+        }
+    }
+    else if (distribution == "organ_pipe") {
+        for (std::size_t i = 0; i < count; ++i) {
+            input.push_back(make_key<T>(std::min(i, count - 1 - i)));
+        }
+    }
+    else if (distribution == "zipf") {
+        // s = 1 over up to 65536 distinct ranks, sampled through the cumulative distribution
+        std::size_t ranks = std::min<std::size_t>(count, 1 << 16);
+        std::vector<double> cumulative(ranks);
+        double sum = 0;
+        for (std::size_t rank = 0; rank < ranks; ++rank) {
+            sum += 1.0 / (rank + 1);
+            cumulative[rank] = sum;
+        }
+        std::uniform_real_distribution<double> uniform(0, sum);
+        for (std::size_t i = 0; i < count; ++i) {
+            auto rank = std::lower_bound(cumulative.begin(), cumulative.end(), uniform(engine)) - cumulative.begin();
+            input.push_back(make_key<T>(std::min<std::size_t>(rank, ranks - 1) * 0x9e3779b97f4a7c15ULL));
+        }
+    }
+    else {
+        for (std::size_t i = 0; i < count; ++i) {
+            input.push_back(make_key<T>(engine()));
+        }
+        if (distribution == "sorted" || distribution == "reversed") {
+            std::sort(input.begin(), input.end());
+        }
+        if (distribution == "reversed") {
+            std::reverse(input.begin(), input.end());
+        }
+    }
+    return input;
+}
+
+struct algorithm_info {
+    const char* name;
+    bool stable;
+    std::size_t max_count;
+};
+
+bool all_correct = true;
+
+// the parallel sorts get a fixed pool instead of default_pool(), which has one thread on a one-core host and
+// would send them down their serial fallback
+tinystl::thread_pool& harness_pool() {
+    static tinystl::thread_pool pool(4);
+    return pool;
+}
+
+// sort is called as sort(data, compare) for the plain and for the instrumented run
+template <typename T, typename Sort>
+void run(const algorithm_info& algorithm, const std::string& type, const std::string& distribution,
+         const std::vector<T>& input, const std::vector<T>& expected, const std::vector<counted<T>>& counted_expected, Sort&& sort) {
+    if (input.size() > algorithm.max_count) {
+        return;
+    }
+    auto data = input;
+    std::size_t baseline = current_bytes.load();
+    peak_bytes.store(baseline);
+    auto start = std::chrono::steady_clock::now();
+    sort(data, std::less_equal<T>{});
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    std::size_t peak = peak_bytes.load() - baseline;
+    bool correct = data == expected;
+
+    std::vector<counted<T>> counted_data;
+    counted_data.reserve(input.size());
+    for (std::size_t i = 0; i < input.size(); ++i) {
+        counted_data.emplace_back(input[i], static_cast<std::uint32_t>(i));
+    }
+    std::atomic<std::uint64_t> comparisons{0};
+    move_count.store(0);
+    sort(counted_data, counting_less_equal<T>{ &comparisons });
+    std::uint64_t moves = move_count.load();
+    if (algorithm.stable) {
+        correct = correct && counted_data == counted_expected;
+    }
+    else {
+        correct = correct && std::equal(counted_data.begin(), counted_data.end(), expected.begin(),
+                                        [](const counted<T>& a, const T& b) { return a.value == b; });
+    }
+    all_correct = all_correct && correct;
+
+    std::cout << algorithm.name << "," << type << "," << distribution << "," << input.size() << ","
+              << ns / std::max<std::size_t>(input.size(), 1) << "," << comparisons.load() << "," << moves << ","
+              << peak << "," << (correct ? "ok" : "WRONG") << std::endl;
+}
+
+// select(data, k, compare) leaves the k smallest elements at the front of data, in order when ordered is set and
+// otherwise with the k-th one last; the rest of data holds the other elements, unless only the k came back
+template <typename T, typename Select>
+void run_selection(const char* name, bool ordered, const std::string& type, const std::string& distribution,
+                   const std::vector<T>& input, const std::vector<T>& expected, std::size_t k, Select&& select) {
+    auto check = [&](const auto& result, auto value) {
+        std::vector<T> values;
+        values.reserve(result.size());
+        for (auto& element : result) {
+            values.push_back(value(element));
+        }
+        if (values.size() != expected.size() && values.size() != k) {
+            return false;
+        }
+        bool nth = ordered || values[k - 1] == expected[k - 1];
+        if (!ordered) {
+            std::sort(values.begin(), values.begin() + k);
+        }
+        bool front = std::equal(values.begin(), values.begin() + k, expected.begin());
+        std::sort(values.begin() + k, values.end());
+        return nth && front && std::equal(values.begin() + k, values.end(), expected.begin() + k);
+    };
+
+    auto data = input;
+    std::size_t baseline = current_bytes.load();
+    peak_bytes.store(baseline);
+    auto start = std::chrono::steady_clock::now();
+    select(data, k, std::less_equal<T>{});
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    std::size_t peak = peak_bytes.load() - baseline;
+    bool correct = check(data, [](const T& v) { return v; });
+
+    std::vector<counted<T>> counted_data;
+    counted_data.reserve(input.size());
+    for (std::size_t i = 0; i < input.size(); ++i) {
+        counted_data.emplace_back(input[i], static_cast<std::uint32_t>(i));
+    }
+    std::atomic<std::uint64_t> comparisons{0};
+    move_count.store(0);
+    select(counted_data, k, counting_less_equal<T>{ &comparisons });
+    std::uint64_t moves = move_count.load();
+    correct = correct && check(counted_data, [](const counted<T>& v) { return v.value; });
+    all_correct = all_correct && correct;
+
+    std::cout << name << "," << type << "," << distribution << "," << input.size() << ","
+              << ns / std::max<std::size_t>(input.size(), 1) << "," << comparisons.load() << "," << moves << ","
+              << peak << "," << (correct ? "ok" : "WRONG") << std::endl;
+}
+
+// external_sort from a raw file and from a mapping of it, both checked against std::sort
+template <typename T>
+void run_external(const std::string& type, const std::string& distribution, const std::vector<T>& input, const std::vector<T>& expected) {
+    tinystl::external_sort_options options;
+    options.memory_budget = 1 << 14;
+    options.io_block = 1 << 12;     // fan-in of 3 runs per merge pass
+    auto dir = std::filesystem::temp_directory_path();
+    auto input_path = dir / "sort_harness_input.bin";
+    auto output_path = dir / "sort_harness_output.bin";
+    {
+        std::FILE* file = std::fopen(input_path.c_str(), "wb");
+        std::fwrite(input.data(), sizeof(T), input.size(), file);
+        std::fclose(file);
+    }
+    auto read_output = [&] {
+        std::vector<T> output(std::filesystem::file_size(output_path) / sizeof(T));
+        std::FILE* file = std::fopen(output_path.c_str(), "rb");
+        output.resize(std::fread(output.data(), sizeof(T), output.size(), file));
+        std::fclose(file);
+        return output;
+    };
+
+    std::atomic<std::uint64_t> comparisons{0};
+    auto compare = [&comparisons](const T& a, const T& b) {
+        comparisons.fetch_add(1, std::memory_order_relaxed);
+        return a <= b;
+    };
+    std::size_t baseline = current_bytes.load();
+    peak_bytes.store(baseline);
+    auto start = std::chrono::steady_clock::now();
+    tinystl::external_sort<T>(input_path, output_path, compare, options);
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    std::size_t peak = peak_bytes.load() - baseline;
+    bool correct = read_output() == expected;
+    tinystl::external_sort_mapped<T>(input_path, output_path, std::less_equal<T>{}, options);
+    correct = correct && read_output() == expected;
+    std::filesystem::remove(input_path);
+    std::filesystem::remove(output_path);
+    all_correct = all_correct && correct;
+
+    std::cout << "external_sort," << type << "," << distribution << "," << input.size() << ","
+              << ns / std::max<std::size_t>(input.size(), 1) << "," << comparisons.load() << ",,"
+              << peak << "," << (correct ? "ok" : "WRONG") << std::endl;
+}
+
+template <typename T>
+void run_all(const std::string& type, const std::vector<std::size_t>& counts, std::mt19937_64& engine) {
+    for (std::size_t count : counts) {
+        for (std::string distribution : { "random", "sorted", "reversed", "few_unique", "organ_pipe", "zipf" }) {
+            auto input = make_input<T>(distribution, count, engine);
+            auto expected = input;
+            std::sort(expected.begin(), expected.end());
+            std::vector<counted<T>> counted_expected;
+            for (std::size_t i = 0; i < input.size(); ++i) {
+                counted_expected.emplace_back(input[i], static_cast<std::uint32_t>(i));
+            }
+            std::stable_sort(counted_expected.begin(), counted_expected.end(),
+                             [](const counted<T>& a, const counted<T>& b) { return a.value < b.value; });
+            if constexpr (std::is_trivially_copyable<T>::value) {
+                run_external(type, distribution, input, expected);
+            }
+
+            auto each = [&](const algorithm_info& algorithm, auto&& sort) {
+                run(algorithm, type, distribution, input, expected, counted_expected, sort);
+            };
+            each({ "insert_sort", false, 1 << 12 }, [](auto& data, auto compare) {
+                tinystl::insert_sort(data.begin(), data.end(), compare);
+            });
+            each({ "select_sort", false, 1 << 12 }, [](auto& data, auto compare) {
+                tinystl::select_sort(data.begin(), data.end(), compare);
+            });
+            each({ "bubble_sort", false, 1 << 12 }, [](auto& data, auto compare) {
+                tinystl::bubble_sort(data.begin(), data.end(), compare);
+            });
+            each({ "quick_sort", false, std::size_t(-1) }, [](auto& data, auto compare) {
+                tinystl::quick_sort(data.begin(), data.end(), compare);
+            });
+            each({ "intro_sort", false, std::size_t(-1) }, [](auto& data, auto compare) {
+                tinystl::intro_sort(data.begin(), data.end(), compare);
+            });
+            each({ "shell_sort", false, std::size_t(-1) }, [](auto& data, auto compare) {
+                tinystl::shell_sort(data.begin(), data.end(), compare);
+            });
+            each({ "heap_sort", false, std::size_t(-1) }, [](auto& data, auto compare) {
+                tinystl::heap_sort(data.begin(), data.end(), compare);
+            });
+            each({ "parallel_quick_sort", false, std::size_t(-1) }, [](auto& data, auto compare) {
+                tinystl::parallel_quick_sort(data.begin(), data.end(), compare, harness_pool());
+            });
+            each({ "merge_sort", true, std::size_t(-1) }, [](auto& data, auto compare) {
+                tinystl::merge_sort(data.begin(), data.end(), compare);
+            });
+            each({ "natural_merge_sort", true, std::size_t(-1) }, [](auto& data, auto compare) {
+                tinystl::natural_merge_sort(data.begin(), data.end(), compare);
+            });
+            each({ "parallel_merge_sort", true, std::size_t(-1) }, [](auto& data, auto compare) {
+                tinystl::parallel_merge_sort(data.begin(), data.end(), compare, harness_pool());
+            });
+            // the permutation argsort returns is applied by hand, indirect_sort applies it in place
+            each({ "argsort", true, std::size_t(-1) }, [](auto& data, auto compare) {
+                auto order = tinystl::argsort(data.begin(), data.end(), [](const auto& v) -> const auto& { return v; }, compare);
+                auto unsorted = std::move(data);
+                data.clear();
+                for (std::size_t index : order) {
+                    data.push_back(std::move(unsorted[index]));
+                }
+            });
+            each({ "indirect_sort", true, std::size_t(-1) }, [](auto& data, auto compare) {
+                tinystl::indirect_sort(data.begin(), data.end(), [](const auto& v) -> const auto& { return v; }, compare);
+            });
+            // the nodes point into data, so the moves are only those of writing the sorted order back
+            each({ "list_merge_sort", true, std::size_t(-1) }, [](auto& data, auto compare) {
+                using value_type = typename std::decay<decltype(data)>::type::value_type;
+                struct node {
+                    value_type* value;
+                    node* next;
+                };
+                std::vector<node> nodes;
+                nodes.reserve(data.size());
+                for (auto& value : data) {
+                    nodes.push_back({ &value, nullptr });
+                }
+                for (std::size_t i = 1; i < nodes.size(); ++i) {
+                    nodes[i - 1].next = &nodes[i];
+                }
+                node* head = tinystl::list_merge_sort(nodes.empty() ? nullptr : &nodes[0], &node::next,
+                                                      [&compare](const node& a, const node& b) { return compare(*a.value, *b.value); });
+                std::vector<value_type> sorted;
+                sorted.reserve(data.size());
+                for (; head != nullptr; head = head->next) {
+                    sorted.push_back(std::move(*head->value));
+                }
+                data = std::move(sorted);
+            });
+            each({ "radix_sort", true, std::size_t(-1) }, [](auto& data, auto) {
+                using value_type = typename std::decay<decltype(data)>::type::value_type;
+                if constexpr (std::is_same<value_type, T>::value) {
+                    tinystl::radix_sort(data.begin(), data.end());
+                }
+                else {
+                    tinystl::radix_sort(data.begin(), data.end(), [](const value_type& v) -> const T& { return v.value; });
+                }
+            });
+
+            // both partial_sort strategies: k below n / 128 keeps a heap, a large k selects and sorts the prefix
+            auto select = [&](const char* name, bool ordered, std::size_t k, auto&& select) {
+                run_selection(name, ordered, type, distribution, input, expected, k, select);
+            };
+            select("nth_element", false, count / 2, [](auto& data, std::size_t k, auto compare) {
+                tinystl::nth_element(data.begin(), data.begin() + (k - 1), data.end(), compare);
+            });
+            select("partial_sort", true, count / 2, [](auto& data, std::size_t k, auto compare) {
+                tinystl::partial_sort(data.begin(), data.begin() + k, data.end(), compare);
+            });
+            select("partial_sort_k16", true, 16, [](auto& data, std::size_t k, auto compare) {
+                tinystl::partial_sort(data.begin(), data.begin() + k, data.end(), compare);
+            });
+            select("top_k_k16", true, 16, [](auto& data, std::size_t k, auto compare) {
+                using value_type = typename std::decay<decltype(data)>::type::value_type;
+                tinystl::top_k<value_type, decltype(compare)> best(k, compare);
+                best.push(data.begin(), data.end());
+                auto kept = best.sorted();
+                data.assign(kept.begin(), kept.end());
+            });
+
+            each({ "std::sort", false, std::size_t(-1) }, [](auto& data, auto compare) {
+                std::sort(data.begin(), data.end(), [&compare](const auto& a, const auto& b) { return !compare(b, a); });
+            });
+            each({ "std::stable_sort", true, std::size_t(-1) }, [](auto& data, auto compare) {
+                std::stable_sort(data.begin(), data.end(), [&compare](const auto& a, const auto& b) { return !compare(b, a); });
+            });
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    std::size_t max_count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    std::vector<std::size_t> counts;
+    for (std::size_t count = 1000; count < max_count; count *= 100) {
+        counts.push_back(count);
+    }
+    counts.push_back(max_count);
+
+    std::mt19937_64 engine(42);
+    std::cout << "algorithm,type,distribution,size,ns_per_element,comparisons,moves,peak_bytes,result" << std::endl;
+    run_external<std::uint64_t>("uint64", "empty", {}, {});
+    run_all<std::int32_t>("int32", counts, engine);
+    run_all<std::uint64_t>("uint64", counts, engine);
+    run_all<double>("double", counts, engine);
+    run_all<std::string>("string", counts, engine);
+    return all_correct ? 0 : 1;
+}
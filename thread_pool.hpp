@@ -0,0 +1,138 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tinystl {
+
+// work-stealing thread pool: every worker owns a deque, pops its own tasks from the back (LIFO)
+// and steals from the front of the other deques (FIFO) when it runs dry
+class thread_pool {
+public:
+    using task_type = std::function<void()>;
+
+    explicit thread_pool(std::size_t thread_count = std::thread::hardware_concurrency())
+        : queues_(thread_count == 0 ? 1 : thread_count) {
+        for (auto& queue : queues_) {
+            queue = std::make_unique<task_queue>();
+        }
+        for (std::size_t i = 0; i < queues_.size(); ++i) {
+            workers_.emplace_back([this, i] { worker_loop(i); });
+        }
+    }
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    ~thread_pool() {
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+            stop_ = true;
+        }
+        sleep_cv_.notify_all();
+        for (auto& worker : workers_) {
+            worker.join();
+        }
+    }
+
+    // tasks submitted from a worker go to its own deque, others are spread round-robin
+    template <typename Func>
+    void submit(Func&& func) {
+        std::size_t index = current_pool_ == this ? current_index_ : next_queue_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+        pending_.fetch_add(1, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+            queues_[index]->tasks.emplace_back(std::forward<Func>(func));
+        }
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+        }
+        sleep_cv_.notify_one();
+    }
+
+    // run one queued task on the calling thread, used to help out while waiting on subtasks
+    bool try_run_one() {
+        task_type task;
+        if (!pop_task(current_pool_ == this ? current_index_ : 0, task)) {
+            return false;
+        }
+        task();
+        return true;
+    }
+
+    std::size_t size() const noexcept { return queues_.size(); }
+
+    static thread_pool& default_pool() {
+        static thread_pool pool;
+        return pool;
+    }
+
+private:
+    struct task_queue {
+        std::mutex mutex;
+        std::deque<task_type> tasks;
+    };
+
+    bool pop_task(std::size_t index, task_type& task) {
+        {
+            std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+            if (!queues_[index]->tasks.empty()) {
+                task = std::move(queues_[index]->tasks.back());
+                queues_[index]->tasks.pop_back();
+                pending_.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        for (std::size_t i = 1; i < queues_.size(); ++i) {
+            auto& victim = *queues_[(index + i) % queues_.size()];
+            std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+            if (lock.owns_lock() && !victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                pending_.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void worker_loop(std::size_t index) {
+        current_pool_ = this;
+        current_index_ = index;
+        task_type task;
+        while (true) {
+            if (pop_task(index, task)) {
+                task();
+                task = nullptr;
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleep_mutex_);
+            if (stop_ && pending_.load(std::memory_order_acquire) == 0) {
+                break;
+            }
+            // a failed try_lock above may have skipped a queue, so never sleep while tasks are pending
+            sleep_cv_.wait(lock, [this] { return stop_ || pending_.load(std::memory_order_acquire) != 0; });
+        }
+        current_pool_ = nullptr;
+    }
+
+    static inline thread_local thread_pool* current_pool_ = nullptr;
+    static inline thread_local std::size_t current_index_ = 0;
+
+    std::vector<std::unique_ptr<task_queue>> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<std::size_t> pending_{0};
+    std::atomic<std::size_t> next_queue_{0};
+    std::mutex sleep_mutex_;
+    std::condition_variable sleep_cv_;
+    bool stop_ = false;
+};
+
+}